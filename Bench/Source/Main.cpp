@@ -0,0 +1,451 @@
+/*
+  ==============================================================================
+
+    Microbenchmarks for the K-wire DSP kernels, the oversampling stages and
+    the full KwireAudioProcessor::processBlock.
+
+    Every result is one line of JSON (or CSV with --csv), so runs can be
+    diffed. nsPerSample is per channel sample, samplesPerSec is sample frames
+    (all channels) per second. Each timed call includes copying the test
+    signal into the work buffer, which costs well under 0.1 ns per sample.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "../../Source/PluginProcessor.h"
+#include "Verify.h"
+
+namespace
+{
+    struct BenchSettings
+    {
+        juce::Array<int> blockSizes { 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+        juce::Array<int> sampleRates { 44100, 48000, 96000, 192000 };
+        juce::Array<int> channels { 1, 2, 8, 12 };
+        juce::StringArray benches { "compress", "overdrive", "output", "oversampling", "processBlock" };
+        double minSeconds = 0.05; //per measurement
+        bool csv = false,
+            verify = false; //check against the reference instead of timing
+    };
+
+    //Signal level and compressor settings for one region of the curve
+    struct Scenario
+    {
+        const char* name;
+        float level, //peak level of the test signal in dB
+            threshold,
+            ratio; //plugin ratio parameter, 0 - 100
+    };
+
+    const Scenario scenarios[] = {
+        { "below", -40.f, -12.f, 50.f }, //never reaches the knee
+        { "knee", -12.f, -12.f, 50.f }, //hovers around the threshold
+        { "deep", 0.f, -24.f, 100.f } //far above the threshold at full ratio
+    };
+
+    struct Result
+    {
+        juce::String bench, variant, scenario;
+        int channels, sampleRate, blockSize;
+        double nsPerCall;
+    };
+
+    void printHeader(const BenchSettings& settings)
+    {
+        if (settings.csv)
+            std::cout << "bench,variant,scenario,channels,sampleRate,blockSize,nsPerSample,samplesPerSec\n";
+    }
+
+    void print(const BenchSettings& settings, const Result& r)
+    {
+        auto nsPerSample = r.nsPerCall / ((double)r.blockSize * r.channels);
+        auto samplesPerSec = (double)r.blockSize * 1.0e9 / r.nsPerCall;
+
+        if (settings.csv)
+            std::cout << r.bench << "," << r.variant << "," << r.scenario << "," << r.channels << "," << r.sampleRate << ","
+                      << r.blockSize << "," << juce::String(nsPerSample, 4) << "," << juce::String(samplesPerSec, 0) << "\n";
+        else
+            std::cout << "{\"bench\":\"" << r.bench << "\",\"variant\":\"" << r.variant << "\",\"scenario\":\"" << r.scenario
+                      << "\",\"channels\":" << r.channels << ",\"sampleRate\":" << r.sampleRate << ",\"blockSize\":" << r.blockSize
+                      << ",\"nsPerSample\":" << juce::String(nsPerSample, 4) << ",\"samplesPerSec\":" << juce::String(samplesPerSec, 0) << "}\n";
+
+        std::cout.flush();
+    }
+
+    //Average time of one call to process, in ns
+    template <typename Fn>
+    double measure(Fn&& process, double minSeconds)
+    {
+        for (int i = 0; i < 8; ++i)
+            process();
+
+        juce::int64 iterations = 0, elapsed = 0;
+        auto start = juce::Time::getHighResolutionTicks();
+
+        do
+        {
+            for (int i = 0; i < 8; ++i)
+                process();
+
+            iterations += 8;
+            elapsed = juce::Time::getHighResolutionTicks() - start;
+        } while (juce::Time::highResolutionTicksToSeconds(elapsed) < minSeconds);
+
+        return juce::Time::highResolutionTicksToSeconds(elapsed) * 1.0e9 / (double)iterations;
+    }
+
+    //Sine plus noise bursts with the given peak level, long enough to loop over without repeating inside a block
+    juce::AudioBuffer<float> makeSignal(int numChannels, int numSamples, double sampleRate, float levelInDb)
+    {
+        juce::AudioBuffer<float> signal(numChannels, numSamples);
+        juce::Random random(1234);
+        auto gain = juce::Decibels::decibelsToGain(levelInDb);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* data = signal.getWritePointer(channel);
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                auto sine = std::sin(juce::MathConstants<double>::twoPi * 220.0 * (channel + 1) * i / sampleRate);
+                auto burst = (i / 2048) % 2 == 0 ? random.nextFloat() * 2.f - 1.f : 0.f;
+                data[i] = gain * (0.7f * (float)sine + 0.3f * burst);
+            }
+        }
+
+        return signal;
+    }
+
+    //Copies the next block of the looping signal into work
+    struct SignalCursor
+    {
+        const juce::AudioBuffer<float>& signal;
+        int position = 0;
+
+        //work may be double, the signal is converted on the way
+        template <typename SampleType>
+        void next(juce::AudioBuffer<SampleType>& work, int numSamples)
+        {
+            if (position + numSamples > signal.getNumSamples())
+                position = 0;
+
+            for (int channel = 0; channel < work.getNumChannels(); ++channel)
+            {
+                auto* source = signal.getReadPointer(channel, position);
+                std::copy(source, source + numSamples, work.getWritePointer(channel));
+            }
+
+            position += numSamples;
+        }
+    };
+
+    const char* getName(K_Simd::InstructionSet set)
+    {
+        switch (set)
+        {
+            case K_Simd::InstructionSet::scalar: return "scalar";
+            case K_Simd::InstructionSet::sse2: return "sse2";
+            case K_Simd::InstructionSet::avx2: return "avx2";
+            case K_Simd::InstructionSet::neon: return "neon";
+        }
+
+        return "scalar";
+    }
+
+    //=====
+    void benchKernels(const BenchSettings& settings, int numChannels)
+    {
+        const K_Simd::InstructionSet sets[] = { K_Simd::InstructionSet::scalar, K_Simd::InstructionSet::sse2, K_Simd::InstructionSet::avx2, K_Simd::InstructionSet::neon };
+
+        for (auto& scenario : scenarios)
+        for (auto sampleRate : settings.sampleRates)
+        {
+            auto signal = makeSignal(numChannels, 1 << 16, sampleRate, scenario.level);
+
+            for (auto blockSize : settings.blockSizes)
+            for (auto set : sets)
+            {
+                if (!K_Simd::isAvailable(set))
+                    continue;
+
+                juce::AudioBuffer<float> work(numChannels, blockSize);
+                juce::dsp::AudioBlock<float> block(work);
+                SignalCursor cursor { signal };
+
+                for (int mode = 0; mode < 2; ++mode)
+                {
+                    K_Kwire<maxSupportedChannels> kwire;
+                    kwire.setNumChannels(numChannels);
+                    kwire.setupParams({ 1.f + scenario.ratio * 0.01f, scenario.threshold, 20.f, 10.f }, sampleRate);
+                    kwire.setInstructionSet(set);
+                    kwire.setDetectorMode(mode == 0 ? K_DetectorMode::exact : K_DetectorMode::fast);
+                    kwire.setShaperMode(mode == 0 ? K_ShaperMode::exact : K_ShaperMode::table);
+
+                    if (settings.benches.contains("compress"))
+                    {
+                        auto ns = measure([&] { cursor.next(work, blockSize); kwire.compress(block); }, settings.minSeconds);
+                        print(settings, { "compress", juce::String(getName(set)) + (mode == 0 ? "/exact" : "/fast"), scenario.name, numChannels, sampleRate, blockSize, ns });
+                    }
+
+                    if (settings.benches.contains("overdrive"))
+                    {
+                        auto ns = measure([&] { cursor.next(work, blockSize); kwire.overdrive(block); }, settings.minSeconds);
+                        print(settings, { "overdrive", juce::String(getName(set)) + (mode == 0 ? "/exact" : "/table"), scenario.name, numChannels, sampleRate, blockSize, ns });
+                    }
+                }
+
+                //one shared detector for all channels
+                if (settings.benches.contains("compress"))
+                {
+                    K_Kwire<maxSupportedChannels> kwire;
+                    kwire.setNumChannels(numChannels);
+                    kwire.setupParams({ 1.f + scenario.ratio * 0.01f, scenario.threshold, 20.f, 10.f }, sampleRate);
+                    kwire.setInstructionSet(set);
+                    kwire.setLinkMode(K_LinkMode::max);
+
+                    auto ns = measure([&] { cursor.next(work, blockSize); kwire.compress(block); }, settings.minSeconds);
+                    print(settings, { "compress", juce::String(getName(set)) + "/linked", scenario.name, numChannels, sampleRate, blockSize, ns });
+                }
+
+                //5 ms lookahead, at the engine rate the plugin would run for this sample rate
+                if (settings.benches.contains("compress"))
+                {
+                    auto lookaheadSamples = juce::roundToInt(0.005 * sampleRate) * 2;
+
+                    K_Kwire<maxSupportedChannels> kwire;
+                    kwire.setNumChannels(numChannels);
+                    kwire.prepareLookahead(lookaheadSamples);
+                    kwire.setLookahead(lookaheadSamples);
+                    kwire.setupParams({ 1.f + scenario.ratio * 0.01f, scenario.threshold, 20.f, 10.f }, sampleRate);
+                    kwire.setInstructionSet(set);
+
+                    auto ns = measure([&] { cursor.next(work, blockSize); kwire.compress(block); }, settings.minSeconds);
+                    print(settings, { "compress", juce::String(getName(set)) + "/lookahead", scenario.name, numChannels, sampleRate, blockSize, ns });
+                }
+
+                //mix and output gain, both ramping
+                if (settings.benches.contains("output"))
+                {
+                    auto& kernels = K_Simd::getKernels(set);
+                    const K_Simd::OutputCoeffs coeffs { 0.5f, 1.0e-4f, 1.f, -1.0e-4f };
+
+                    juce::AudioBuffer<float> dry;
+                    cursor.next(work, blockSize);
+                    dry.makeCopyOf(work);
+
+                    auto ns = measure([&]
+                    {
+                        cursor.next(work, blockSize);
+                        float sum, peak;
+
+                        for (int channel = 0; channel < numChannels; ++channel)
+                            kernels.mixAndGain(work.getWritePointer(channel), dry.getReadPointer(channel), blockSize, coeffs, sum, peak);
+                    }, settings.minSeconds);
+
+                    print(settings, { "output", getName(set), scenario.name, numChannels, sampleRate, blockSize, ns });
+                }
+            }
+        }
+    }
+
+    //=====
+    //The oversampler the plugin runs, built as the processor builds it
+    void benchOversampling(const BenchSettings& settings, int numChannels)
+    {
+        for (auto sampleRate : settings.sampleRates)
+        {
+            auto signal = makeSignal(numChannels, 1 << 16, sampleRate, -6.f);
+
+            for (auto blockSize : settings.blockSizes)
+            for (int factor = 1; factor <= maxOversamplingIndex; ++factor)
+            for (int filter = 0; filter < 2; ++filter) //osFilter: FIR, IIR
+            {
+                auto oversampler = KwireAudioProcessor::makeOversampler<float>(numChannels, factor, filter, blockSize);
+
+                juce::AudioBuffer<float> work(numChannels, blockSize);
+                juce::dsp::AudioBlock<float> block(work);
+                SignalCursor cursor { signal };
+
+                //up and down are timed separately inside the same loop, so down always sees fresh upsampled data
+                juce::int64 upTicks = 0, downTicks = 0, calls = 0;
+                auto start = juce::Time::getHighResolutionTicks();
+
+                do
+                {
+                    cursor.next(work, blockSize);
+
+                    auto t0 = juce::Time::getHighResolutionTicks();
+                    oversampler->processSamplesUp(block);
+                    auto t1 = juce::Time::getHighResolutionTicks();
+                    oversampler->processSamplesDown(block);
+                    auto t2 = juce::Time::getHighResolutionTicks();
+
+                    upTicks += t1 - t0;
+                    downTicks += t2 - t1;
+                    ++calls;
+                } while (juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) < settings.minSeconds);
+
+                auto variant = juce::String(1 << factor) + "x/" + (filter == 0 ? "FIR" : "IIR");
+
+                print(settings, { "osUp", variant, "-", numChannels, sampleRate, blockSize, juce::Time::highResolutionTicksToSeconds(upTicks) * 1.0e9 / (double)calls });
+                print(settings, { "osDown", variant, "-", numChannels, sampleRate, blockSize, juce::Time::highResolutionTicksToSeconds(downTicks) * 1.0e9 / (double)calls });
+            }
+        }
+    }
+
+    //=====
+    void benchProcessor(const BenchSettings& settings, int numChannels)
+    {
+        //tracking and mixdown configurations, the tracking one again in double precision, and with host blocks
+        //four times longer than the size the processor was prepared for
+        const char* configs[][4] = { { "2x", "FIR", "float", "" }, { "2x", "IIR", "float", "" }, { "8x", "FIR", "float", "" },
+                                     { "2x", "FIR", "double", "" }, { "2x", "FIR", "float", "oversize" } };
+
+        for (auto& scenario : scenarios)
+        for (auto sampleRate : settings.sampleRates)
+        {
+            auto signal = makeSignal(numChannels, 1 << 16, sampleRate, scenario.level);
+
+            for (auto blockSize : settings.blockSizes)
+            for (auto& config : configs)
+            {
+                KwireAudioProcessor processor;
+
+                auto layout = processor.getBusesLayout();
+                layout.inputBuses.getReference(0) = juce::AudioChannelSet::canonicalChannelSet(numChannels);
+                layout.outputBuses.getReference(0) = juce::AudioChannelSet::canonicalChannelSet(numChannels);
+
+                if (!processor.setBusesLayout(layout))
+                    return;
+
+                auto set = [&processor](const char* id, const juce::String& value)
+                {
+                    auto* param = processor.treestate.getParameter(id);
+                    param->setValueNotifyingHost(param->getValueForText(value));
+                };
+
+                set("compThreshold", juce::String(scenario.threshold));
+                set("compRatio", juce::String(scenario.ratio));
+                set("oversampling", config[0]);
+                set("osFilter", config[1]);
+
+                const bool useDouble = juce::String(config[2]) == "double";
+                const bool oversize = juce::String(config[3]) == "oversize";
+                const auto preparedBlockSize = oversize ? juce::jmax(1, blockSize / 4) : blockSize;
+
+                processor.setProcessingPrecision(useDouble ? juce::AudioProcessor::doublePrecision : juce::AudioProcessor::singlePrecision);
+                processor.setRateAndBufferSizeDetails(sampleRate, preparedBlockSize);
+                processor.prepareToPlay(sampleRate, preparedBlockSize);
+
+                juce::MidiBuffer midi;
+                SignalCursor cursor { signal };
+
+                auto run = [&](auto& work) { return measure([&] { cursor.next(work, blockSize); processor.processBlock(work, midi); }, settings.minSeconds); };
+
+                juce::AudioBuffer<float> work(numChannels, useDouble ? 0 : blockSize);
+                juce::AudioBuffer<double> doubleWork(numChannels, useDouble ? blockSize : 0);
+
+                auto ns = useDouble ? run(doubleWork) : run(work);
+
+                auto variant = juce::String(config[0]) + "/" + config[1] + (useDouble ? "/double" : "") + (oversize ? "/oversize" : "");
+                print(settings, { "processBlock", variant, scenario.name, numChannels, sampleRate, blockSize, ns });
+
+                processor.releaseResources();
+            }
+        }
+    }
+
+    juce::Array<int> parseList(const juce::String& text)
+    {
+        juce::Array<int> values;
+
+        for (auto& item : juce::StringArray::fromTokens(text, ",", ""))
+            values.add(item.getIntValue());
+
+        return values;
+    }
+
+    void printUsage()
+    {
+        std::cout << "Usage: KwireBench [options]\n"
+                     "\n"
+                     "  --bench <list>     any of compress,overdrive,output,oversampling,processBlock (default: all)\n"
+                     "  --blocks <list>    block sizes (default: 32,64,128,256,512,1024,2048,4096)\n"
+                     "  --rates <list>     sample rates (default: 44100,48000,96000,192000)\n"
+                     "  --channels <list>  channel counts, 1 to 16 (default: 1,2,8,12)\n"
+                     "  --time <seconds>   minimum time per measurement (default: 0.05)\n"
+                     "  --csv              CSV instead of JSON lines\n"
+                     "  --verify           compare every optimized path against the frozen reference instead,\n"
+                     "                     exiting non-zero if any is out of tolerance\n";
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    BenchSettings settings;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        juce::String arg(argv[i]);
+        juce::String value(i + 1 < argc ? argv[i + 1] : "");
+
+        if (arg == "--csv")
+        {
+            settings.csv = true;
+            continue;
+        }
+
+        if (arg == "--verify")
+        {
+            settings.verify = true;
+            continue;
+        }
+
+        if (arg == "--bench")
+            settings.benches = juce::StringArray::fromTokens(value, ",", "");
+        else if (arg == "--blocks")
+            settings.blockSizes = parseList(value);
+        else if (arg == "--rates")
+            settings.sampleRates = parseList(value);
+        else if (arg == "--channels")
+            settings.channels = parseList(value);
+        else if (arg == "--time")
+            settings.minSeconds = value.getDoubleValue();
+        else
+        {
+            printUsage();
+            return arg == "--help" ? 0 : 1;
+        }
+
+        ++i;
+    }
+
+    if (settings.verify)
+        return runVerification(settings.csv) == 0 ? 0 : 1;
+
+    printHeader(settings);
+
+    for (auto numChannels : settings.channels)
+    {
+        if (numChannels < 1 || numChannels > maxSupportedChannels)
+        {
+            std::cerr << "Skipping " << numChannels << " channels, the engine supports 1 to " << maxSupportedChannels << "\n";
+            continue;
+        }
+
+        if (settings.benches.contains("compress") || settings.benches.contains("overdrive") || settings.benches.contains("output"))
+            benchKernels(settings, numChannels);
+
+        if (settings.benches.contains("oversampling"))
+            benchOversampling(settings, numChannels);
+
+        if (settings.benches.contains("processBlock"))
+            benchProcessor(settings, numChannels);
+    }
+
+    return 0;
+}
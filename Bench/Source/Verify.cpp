@@ -0,0 +1,511 @@
+/*
+  ==============================================================================
+
+    KwireBench --verify: every optimized path of K_Kwire against
+    K_KwireReference, the frozen scalar compressor and overdrive, and
+    K_Oversampler against the juce::dsp::Oversampling it stands in for.
+
+    Each variant (instruction set, detector, shaper, precision) runs the same
+    deterministic signals and parameter automation as the reference, in
+    uneven blocks. Per signal it reports the largest sample error, the error
+    level relative to the reference in dB, and how far the compressor's gain
+    drifted from the reference's envelope in dB. Anything over the variant's
+    tolerance fails, and KwireBench exits non-zero.
+
+  ==============================================================================
+*/
+
+#include "Verify.h"
+#include <iostream>
+#include "../../Source/PluginProcessor.h"
+#include "../../Source/K_KwireReference.h"
+#include "../../Source/K_Oversampler.h"
+
+namespace
+{
+    //Engine rate of the plugin at 44.1 kHz and 2x oversampling
+    constexpr double verifyRate = 88200.0;
+    constexpr int signalLength = 88200 * 3 / 2;
+    constexpr int automationInterval = 8192;
+    constexpr int verifyChannels[] = { 2, 5 }; //5 leaves a partly filled register on every instruction set
+
+    //Stepped at automationInterval, jumps rather than ramps so the reference can follow exactly
+    const K_KwireParams automation[] = {
+        { 1.0f, -12.f, 20.f, 10.f },
+        { 2.0f, -24.f, 0.1f, 800.f },
+        { 1.5f, -6.f, 5.f, 50.f },
+        { 1.9f, -20.f, 200.f, 0.1f },
+        { 1.25f, 0.f, 1.f, 100.f }
+    };
+
+    //Block sizes cycled through, so chunk and segment boundaries land everywhere
+    constexpr int blockSizes[] = { 512, 37, 1024, 1, 300, 4096, 64 };
+    constexpr int maxBlockSize = 4096;
+
+    struct Tolerance
+    {
+        double maxAbsError, errorDb, envelopeDb;
+    };
+
+    //Exact paths only differ by float rounding. The approximations are held to what they claim: the shaper table
+    //within its measured K_Simd::shaperTableMaxError of the curve (on top of the rounding), the fast detector within 0.003 dB.
+    constexpr Tolerance exactTolerance { 1.0e-5, -110.0, 1.0e-4 },
+        tableTolerance { K_Simd::shaperTableMaxError + exactTolerance.maxAbsError, -100.0, 1.0e-4 },
+        fastTolerance { 1.0e-3, -70.0, 0.003 };
+
+    struct Variant
+    {
+        K_Simd::InstructionSet instructionSet;
+        K_DetectorMode detector;
+        K_ShaperMode shaper;
+        bool useDouble;
+
+        juce::String getName() const
+        {
+            const char* sets[] = { "scalar", "sse2", "avx2", "neon" };
+
+            return juce::String(sets[(int)instructionSet]) + (detector == K_DetectorMode::fast ? "/fast" : "/exact")
+                 + (shaper == K_ShaperMode::table ? "/table" : "/exact") + (useDouble ? "/double" : "/float");
+        }
+
+        //the loosest of the approximations in use
+        const Tolerance& getTolerance() const
+        {
+            if (detector == K_DetectorMode::fast)
+                return fastTolerance;
+
+            return shaper == K_ShaperMode::table ? tableTolerance : exactTolerance;
+        }
+    };
+
+    struct Signal
+    {
+        const char* name;
+        juce::AudioBuffer<float> data;
+    };
+
+    //=====
+    //Test signals. Every channel gets its own variation, so per-channel state can't hide behind identical lanes.
+
+    juce::AudioBuffer<float> makeSweep(int numChannels)
+    {
+        juce::AudioBuffer<float> signal(numChannels, signalLength);
+
+        //log sweep 20 Hz to 20 kHz, rising from -40 to +6 dB so it crosses the whole curve
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* data = signal.getWritePointer(channel);
+            double phase = 0.25 * channel;
+
+            for (int i = 0; i < signalLength; ++i)
+            {
+                auto position = (double)i / signalLength;
+                auto frequency = 20.0 * std::pow(1000.0, position);
+
+                phase += frequency / verifyRate;
+                data[i] = juce::Decibels::decibelsToGain(-40.f + 46.f * (float)position) * (float)std::sin(juce::MathConstants<double>::twoPi * phase);
+            }
+        }
+
+        return signal;
+    }
+
+    juce::AudioBuffer<float> makeNoiseBursts(int numChannels)
+    {
+        juce::AudioBuffer<float> signal(numChannels, signalLength);
+        juce::Random random(4321);
+        const float levels[] = { -30.f, -12.f, 0.f, 6.f };
+        const int burstLength = (int)(0.05 * verifyRate);
+
+        //50 ms on, 150 ms off, cycling through the levels
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* data = signal.getWritePointer(channel);
+
+            for (int i = 0; i < signalLength; ++i)
+            {
+                auto burst = i / burstLength;
+                auto gain = burst % 4 == 0 ? juce::Decibels::decibelsToGain(levels[(burst / 4 + channel) % 4]) : 0.f;
+
+                data[i] = gain * (random.nextFloat() * 2.f - 1.f);
+            }
+        }
+
+        return signal;
+    }
+
+    juce::AudioBuffer<float> makeTransients(int numChannels)
+    {
+        juce::AudioBuffer<float> signal(numChannels, signalLength);
+        const int spacing = (int)(0.1 * verifyRate);
+
+        //decaying 1 kHz clicks every 100 ms, alternating in sign, up to +12 dB
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* data = signal.getWritePointer(channel);
+
+            for (int i = 0; i < signalLength; ++i)
+            {
+                auto hit = (i + channel * 97) / spacing;
+                auto age = (i + channel * 97) % spacing;
+                auto peak = juce::Decibels::decibelsToGain(-24.f + 6.f * (float)(hit % 7)) * (hit % 2 == 0 ? 1.f : -1.f);
+
+                data[i] = peak * std::exp(-(float)age / 400.f) * (float)std::sin(juce::MathConstants<double>::twoPi * 1000.0 * age / verifyRate);
+            }
+        }
+
+        return signal;
+    }
+
+    juce::AudioBuffer<float> makeDC(int numChannels)
+    {
+        juce::AudioBuffer<float> signal(numChannels, signalLength);
+        const float steps[] = { 0.5f, -0.8f, 0.f, 1.5f, -1.5f, 0.01f };
+        const int stepLength = signalLength / (int)std::size(steps) + 1;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* data = signal.getWritePointer(channel);
+
+            for (int i = 0; i < signalLength; ++i)
+                data[i] = steps[(i / stepLength + channel) % (int)std::size(steps)];
+        }
+
+        return signal;
+    }
+
+    juce::AudioBuffer<float> makeDenormals(int numChannels)
+    {
+        juce::AudioBuffer<float> signal(numChannels, signalLength);
+        juce::Random random(99);
+
+        //denormal-range noise, then a loud stretch the envelopes have to recover into
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* data = signal.getWritePointer(channel);
+
+            for (int i = 0; i < signalLength; ++i)
+            {
+                if (i < signalLength * 3 / 4)
+                    data[i] = std::numeric_limits<float>::denorm_min() * (float)random.nextInt(1 << 20) * (random.nextBool() ? 1.f : -1.f);
+                else
+                    data[i] = 0.9f * (float)std::sin(juce::MathConstants<double>::twoPi * 440.0 * (channel + 1) * i / verifyRate);
+            }
+        }
+
+        return signal;
+    }
+
+    //=====
+    //Runs the signal through both engines block by block, with the same automation. Stage: compress only, or compress then overdrive.
+
+    template <typename SampleType>
+    void runEngine(const Variant& variant, const juce::AudioBuffer<float>& input, bool overdrive, juce::AudioBuffer<float>& output)
+    {
+        const int numChannels = input.getNumChannels();
+
+        K_Kwire<maxSupportedChannels, SampleType> kwire;
+        kwire.setNumChannels(numChannels);
+        kwire.setInstructionSet(variant.instructionSet);
+        kwire.setDetectorMode(variant.detector);
+        kwire.setShaperMode(variant.shaper);
+
+        juce::AudioBuffer<SampleType> work;
+        work.makeCopyOf(input);
+
+        for (int start = 0, block = 0; start < signalLength; ++block)
+        {
+            if (start % automationInterval == 0)
+                kwire.setupParams(automation[(start / automationInterval) % (int)std::size(automation)], verifyRate);
+
+            const int nextChange = (start / automationInterval + 1) * automationInterval;
+            const int count = juce::jmin(blockSizes[block % (int)std::size(blockSizes)], nextChange - start, signalLength - start);
+
+            juce::dsp::AudioBlock<SampleType> audioBlock(work.getArrayOfWritePointers(), (size_t)numChannels, (size_t)start, (size_t)count);
+
+            if (overdrive)
+                kwire.process(audioBlock);
+            else
+                kwire.compress(audioBlock);
+
+            start += count;
+        }
+
+        output.makeCopyOf(work);
+    }
+
+    void runReference(const juce::AudioBuffer<float>& input, bool overdrive, juce::AudioBuffer<float>& output)
+    {
+        const int numChannels = input.getNumChannels();
+
+        K_KwireReference<maxSupportedChannels> reference;
+        reference.setNumChannels(numChannels);
+
+        output.makeCopyOf(input);
+
+        float* channels[maxSupportedChannels];
+
+        for (int start = 0; start < signalLength; start += automationInterval)
+        {
+            const int count = juce::jmin(automationInterval, signalLength - start);
+
+            reference.setParams(automation[(start / automationInterval) % (int)std::size(automation)], verifyRate);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                channels[channel] = output.getWritePointer(channel, start);
+
+            reference.compress(channels, count);
+
+            if (overdrive)
+                reference.overdrive(channels, count);
+        }
+    }
+
+    struct Comparison
+    {
+        double maxAbsError = 0.0,
+            errorDb = -200.0,
+            envelopeDb = 0.0;
+    };
+
+    //Sample error of the full path
+    void compareOutput(const juce::AudioBuffer<float>& reference, const juce::AudioBuffer<float>& optimized, Comparison& result)
+    {
+        double errorSquares = 0.0, referenceSquares = 0.0;
+
+        for (int channel = 0; channel < reference.getNumChannels(); ++channel)
+        {
+            auto* ref = reference.getReadPointer(channel);
+            auto* opt = optimized.getReadPointer(channel);
+
+            for (int i = 0; i < reference.getNumSamples(); ++i)
+            {
+                const double error = std::abs((double)opt[i] - (double)ref[i]);
+
+                result.maxAbsError = juce::jmax(result.maxAbsError, error);
+                errorSquares += error * error;
+                referenceSquares += (double)ref[i] * ref[i];
+            }
+        }
+
+        if (errorSquares > 0.0)
+            result.errorDb = 10.0 * std::log10(errorSquares / juce::jmax(referenceSquares, 1.0e-30));
+    }
+
+    //Compressor gain against the reference's, wherever the input is loud enough for the ratio to mean something
+    void compareEnvelope(const juce::AudioBuffer<float>& input, const juce::AudioBuffer<float>& reference, const juce::AudioBuffer<float>& optimized, Comparison& result)
+    {
+        for (int channel = 0; channel < input.getNumChannels(); ++channel)
+        {
+            auto* in = input.getReadPointer(channel);
+            auto* ref = reference.getReadPointer(channel);
+            auto* opt = optimized.getReadPointer(channel);
+
+            for (int i = 0; i < input.getNumSamples(); ++i)
+            {
+                if (std::abs(in[i]) < 1.0e-3f || std::abs(ref[i]) < 1.0e-6f)
+                    continue;
+
+                const double divergence = std::abs(20.0 * std::log10(std::abs((double)opt[i] / (double)ref[i])));
+
+                result.envelopeDb = juce::jmax(result.envelopeDb, divergence);
+            }
+        }
+    }
+
+    //=====
+    //K_Oversampler against juce::dsp::Oversampling with the same stages. Same filters, same arithmetic: only rounding may differ.
+
+    constexpr Tolerance oversamplerTolerance { 1.0e-6, -120.0, 0.0 };
+
+    //JUCE's own, with the stages KwireAudioProcessor::makeOversampler builds
+    template <typename SampleType>
+    void addStages(juce::dsp::Oversampling<SampleType>& oversampler, int factorIndex, bool iir)
+    {
+        using FilterType = typename juce::dsp::Oversampling<SampleType>::FilterType;
+
+        oversampler.setUsingIntegerLatency(true);
+
+        if (factorIndex == 0)
+            oversampler.addDummyOversamplingStage();
+
+        for (int stage = 0; stage < factorIndex; ++stage)
+        {
+            auto transitionWidth = stage == 0 ? 0.15f : 0.3f;
+            auto attenuation = -90.0f + 10.0f * stage;
+
+            oversampler.addOversamplingStage(iir ? FilterType::filterHalfBandPolyphaseIIR : FilterType::filterHalfBandFIREquiripple,
+                                             transitionWidth, attenuation, transitionWidth, attenuation);
+        }
+
+        oversampler.initProcessing((size_t)maxBlockSize);
+    }
+
+    //Up then straight back down, in uneven blocks. Keeps the upsampled signal too. Returns the latency, in whole samples.
+    template <typename SampleType, typename OversamplerType>
+    int runOversampler(OversamplerType& oversampler, const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& upsampled, juce::AudioBuffer<float>& output)
+    {
+        const int numChannels = input.getNumChannels();
+        const int factor = (int)oversampler.getOversamplingFactor();
+
+        juce::AudioBuffer<SampleType> work;
+        work.makeCopyOf(input);
+        upsampled.setSize(numChannels, signalLength * factor);
+
+        for (int start = 0, block = 0; start < signalLength; ++block)
+        {
+            const int count = juce::jmin(blockSizes[block % (int)std::size(blockSizes)], signalLength - start);
+
+            juce::dsp::AudioBlock<SampleType> audioBlock(work.getArrayOfWritePointers(), (size_t)numChannels, (size_t)start, (size_t)count);
+            auto upBlock = oversampler.processSamplesUp(audioBlock);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                for (int i = 0; i < count * factor; ++i)
+                    upsampled.setSample(channel, start * factor + i, (float)upBlock.getSample(channel, i));
+
+            oversampler.processSamplesDown(audioBlock);
+            start += count;
+        }
+
+        output.makeCopyOf(work);
+
+        return (int)oversampler.getLatencyInSamples();
+    }
+
+    template <typename SampleType>
+    bool verifyOversampler(const juce::AudioBuffer<float>& input, int factorIndex, bool iir, Comparison& result)
+    {
+        const auto numChannels = (size_t)input.getNumChannels();
+        juce::AudioBuffer<float> referenceUp, referenceOut, optimizedUp, optimizedOut;
+
+        juce::dsp::Oversampling<SampleType> reference(numChannels);
+        addStages(reference, factorIndex, iir);
+        auto referenceLatency = runOversampler<SampleType>(reference, input, referenceUp, referenceOut);
+
+        auto optimized = KwireAudioProcessor::makeOversampler<SampleType>((int)numChannels, factorIndex, iir ? 1 : 0, maxBlockSize);
+        auto optimizedLatency = runOversampler<SampleType>(*optimized, input, optimizedUp, optimizedOut);
+
+        Comparison up;
+        compareOutput(referenceUp, optimizedUp, up);
+        compareOutput(referenceOut, optimizedOut, result);
+
+        result.maxAbsError = juce::jmax(result.maxAbsError, up.maxAbsError);
+        result.errorDb = juce::jmax(result.errorDb, up.errorDb);
+
+        //the host is told this latency, so it has to be the same exactly
+        return referenceLatency == optimizedLatency;
+    }
+
+    void print(bool csv, const juce::String& variant, const char* signal, int numChannels, const Comparison& r, bool pass)
+    {
+        if (csv)
+            std::cout << variant << "," << signal << "," << numChannels << "," << juce::String(r.maxAbsError, 9) << ","
+                      << juce::String(r.errorDb, 1) << "," << juce::String(r.envelopeDb, 6) << "," << (pass ? "pass" : "FAIL") << "\n";
+        else
+            std::cout << "{\"verify\":\"" << variant << "\",\"signal\":\"" << signal << "\",\"channels\":" << numChannels
+                      << ",\"maxAbsError\":" << juce::String(r.maxAbsError, 9) << ",\"errorDb\":" << juce::String(r.errorDb, 1)
+                      << ",\"envelopeDb\":" << juce::String(r.envelopeDb, 6) << ",\"pass\":" << (pass ? "true" : "false") << "}\n";
+
+        std::cout.flush();
+    }
+}
+
+int runVerification(bool csv)
+{
+    //the plugin runs with denormals flushed, so the reference does too
+    juce::ScopedNoDenormals noDenormals;
+
+    juce::Array<Variant> variants;
+
+    for (auto set : { K_Simd::InstructionSet::scalar, K_Simd::InstructionSet::sse2, K_Simd::InstructionSet::avx2, K_Simd::InstructionSet::neon })
+    {
+        if (!K_Simd::isAvailable(set))
+            continue;
+
+        for (auto detector : { K_DetectorMode::exact, K_DetectorMode::fast })
+        for (auto shaper : { K_ShaperMode::exact, K_ShaperMode::table })
+        for (auto useDouble : { false, true })
+            variants.add({ set, detector, shaper, useDouble });
+    }
+
+    if (csv)
+        std::cout << "variant,signal,channels,maxAbsError,errorDb,envelopeDb,result\n";
+
+    int failures = 0;
+
+    for (auto numChannels : verifyChannels)
+    {
+        Signal signals[] = {
+            { "sweep", makeSweep(numChannels) },
+            { "noiseBursts", makeNoiseBursts(numChannels) },
+            { "transients", makeTransients(numChannels) },
+            { "dc", makeDC(numChannels) },
+            { "denormals", makeDenormals(numChannels) }
+        };
+
+        for (auto& signal : signals)
+        {
+            juce::AudioBuffer<float> referenceFull, referenceCompressed, optimizedFull, optimizedCompressed;
+            runReference(signal.data, true, referenceFull);
+            runReference(signal.data, false, referenceCompressed);
+
+            for (auto& variant : variants)
+            {
+                if (variant.useDouble)
+                {
+                    runEngine<double>(variant, signal.data, true, optimizedFull);
+                    runEngine<double>(variant, signal.data, false, optimizedCompressed);
+                }
+                else
+                {
+                    runEngine<float>(variant, signal.data, true, optimizedFull);
+                    runEngine<float>(variant, signal.data, false, optimizedCompressed);
+                }
+
+                Comparison result;
+                compareOutput(referenceFull, optimizedFull, result);
+                compareEnvelope(signal.data, referenceCompressed, optimizedCompressed, result);
+
+                auto& tolerance = variant.getTolerance();
+                const bool pass = result.maxAbsError <= tolerance.maxAbsError && result.errorDb <= tolerance.errorDb && result.envelopeDb <= tolerance.envelopeDb;
+
+                print(csv, variant.getName(), signal.name, numChannels, result, pass);
+
+                if (!pass)
+                    ++failures;
+            }
+        }
+    }
+
+    //the oversampler, on the signals with the most high frequency content
+    for (auto numChannels : verifyChannels)
+    {
+        Signal signals[] = {
+            { "sweep", makeSweep(numChannels) },
+            { "noiseBursts", makeNoiseBursts(numChannels) },
+            { "transients", makeTransients(numChannels) }
+        };
+
+        for (auto& signal : signals)
+        for (int factorIndex = 0; factorIndex <= maxOversamplingIndex; ++factorIndex)
+        for (auto iir : { false, true })
+        for (auto useDouble : { false, true })
+        {
+            Comparison result;
+            const bool sameLatency = useDouble ? verifyOversampler<double>(signal.data, factorIndex, iir, result)
+                                               : verifyOversampler<float>(signal.data, factorIndex, iir, result);
+
+            const bool pass = sameLatency && result.maxAbsError <= oversamplerTolerance.maxAbsError && result.errorDb <= oversamplerTolerance.errorDb;
+            auto name = juce::String("oversampler/") + juce::String(1 << factorIndex) + "x" + (iir ? "/iir" : "/fir") + (useDouble ? "/double" : "/float");
+
+            print(csv, name, signal.name, numChannels, result, pass);
+
+            if (!pass)
+                ++failures;
+        }
+    }
+
+    std::cerr << (failures == 0 ? juce::String("All variants within tolerance\n") : juce::String(failures) + " results out of tolerance\n");
+
+    return failures;
+}
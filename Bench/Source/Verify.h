@@ -0,0 +1,7 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//Runs every instruction set, detector, shaper and precision of K_Kwire through the test signals next to
+//K_KwireReference, printing one result per variant and signal. Returns the number of results out of tolerance.
+int runVerification(bool csv);
@@ -0,0 +1,398 @@
+/*
+  ==============================================================================
+
+    Headless batch renderer. Streams audio files through KwireAudioProcessor
+    in fixed-size blocks, without an editor, one processor per worker thread.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "../../Source/PluginProcessor.h"
+
+namespace
+{
+    struct RenderSettings
+    {
+        juce::File stateFile;
+        juce::StringPairArray params; //parameter ID -> value text, applied after the state file
+        juce::File outputDir;
+        juce::File traceFile; //Chrome trace of every worker's processor, KWIRE_PROFILING builds only
+        juce::String format; //"wav" or "aiff", empty keeps the input's format
+        juce::String suffix = "_kwire";
+        int bitDepth = 0; //0 keeps the input's depth
+        int blockSize = 512;
+        int numThreads = juce::SystemStats::getNumCpus();
+        juce::Array<juce::File> inputs;
+    };
+
+    void printUsage()
+    {
+        std::cout << "Usage: KwireRender [options] <input files...>\n"
+                     "\n"
+                     "  --state <file>        plugin state saved by the plugin (getStateInformation)\n"
+                     "  --param <id>=<value>  set a parameter, e.g. compThreshold=-18 or oversampling=4x. Repeatable\n"
+                     "  --out <dir>           output directory (default: next to each input)\n"
+                     "  --suffix <text>       appended to output file names (default: _kwire)\n"
+                     "  --format wav|aiff     output format (default: same as input)\n"
+                     "  --bits <n>            output bit depth (default: same as input)\n"
+                     "  --block <n>           processing block size (default: 512)\n"
+                     "  --threads <n>         worker threads, one processor each (default: number of CPUs)\n"
+                     "  --trace <file>        write per-stage timings as Chrome trace JSON (KWIRE_PROFILING builds)\n";
+    }
+
+    bool parseArgs(const juce::StringArray& args, RenderSettings& settings, juce::String& error)
+    {
+        for (int i = 0; i < args.size(); ++i)
+        {
+            auto arg = args[i];
+
+            if (!arg.startsWith("--"))
+            {
+                juce::File input = juce::File::getCurrentWorkingDirectory().getChildFile(arg);
+
+                if (!input.existsAsFile())
+                {
+                    error = "No such file: " + arg;
+                    return false;
+                }
+
+                settings.inputs.add(input);
+                continue;
+            }
+
+            if (i + 1 >= args.size())
+            {
+                error = "Missing value for " + arg;
+                return false;
+            }
+
+            auto value = args[++i];
+
+            if (arg == "--state")
+                settings.stateFile = juce::File::getCurrentWorkingDirectory().getChildFile(value);
+            else if (arg == "--param" && value.containsChar('='))
+                settings.params.set(value.upToFirstOccurrenceOf("=", false, false), value.fromFirstOccurrenceOf("=", false, false));
+            else if (arg == "--out")
+                settings.outputDir = juce::File::getCurrentWorkingDirectory().getChildFile(value);
+            else if (arg == "--suffix")
+                settings.suffix = value;
+            else if (arg == "--format" && (value == "wav" || value == "aiff"))
+                settings.format = value;
+            else if (arg == "--bits")
+                settings.bitDepth = value.getIntValue();
+            else if (arg == "--block")
+                settings.blockSize = value.getIntValue();
+            else if (arg == "--threads")
+                settings.numThreads = value.getIntValue();
+            else if (arg == "--trace")
+                settings.traceFile = juce::File::getCurrentWorkingDirectory().getChildFile(value);
+            else
+            {
+                error = "Bad option: " + arg + " " + value;
+                return false;
+            }
+        }
+
+        if (settings.inputs.isEmpty())
+            error = "No input files";
+        else if (settings.blockSize <= 0 || settings.numThreads <= 0)
+            error = "Block size and thread count must be positive";
+        else if (settings.stateFile != juce::File() && !settings.stateFile.existsAsFile())
+            error = "No such state file: " + settings.stateFile.getFullPathName();
+        else if (settings.traceFile != juce::File() && !KWIRE_PROFILING)
+            error = "--trace needs a build with KWIRE_PROFILING";
+
+        return error.isEmpty();
+    }
+
+    //State file first, then individual parameters on top
+    bool applySettings(KwireAudioProcessor& processor, const RenderSettings& settings, juce::String& error)
+    {
+        if (settings.stateFile != juce::File())
+        {
+            juce::MemoryBlock state;
+
+            if (!settings.stateFile.loadFileAsData(state))
+            {
+                error = "Could not read " + settings.stateFile.getFullPathName();
+                return false;
+            }
+
+            processor.setStateInformation(state.getData(), (int)state.getSize());
+        }
+
+        for (auto& id : settings.params.getAllKeys())
+        {
+            auto* param = processor.treestate.getParameter(id);
+
+            if (param == nullptr)
+            {
+                error = "Unknown parameter: " + id;
+                return false;
+            }
+
+            param->setValueNotifyingHost(param->getValueForText(settings.params[id]));
+        }
+
+        processor.setNonRealtime(true);
+        return true;
+    }
+
+    class RenderWorker : public juce::Thread
+    {
+    public:
+        RenderWorker(const RenderSettings& s, std::unique_ptr<KwireAudioProcessor> p, std::atomic<int>& next, juce::CriticalSection& lock)
+            : juce::Thread("KwireRender worker"),
+            settings(s),
+            processor(std::move(p)),
+            nextFile(next),
+            consoleLock(lock)
+        {
+            formatManager.registerBasicFormats();
+        }
+
+        ~RenderWorker() override
+        {
+            stopThread(-1);
+        }
+
+        void run() override
+        {
+            for (int index = nextFile++; index < settings.inputs.size() && !threadShouldExit(); index = nextFile++)
+            {
+                auto input = settings.inputs[index];
+                juce::String error;
+                auto start = juce::Time::getMillisecondCounterHiRes();
+                juce::int64 length = 0;
+                double sampleRate = 0.0;
+
+                auto ok = renderFile(input, length, sampleRate, error);
+                auto seconds = (juce::Time::getMillisecondCounterHiRes() - start) * 0.001;
+
+                const juce::ScopedLock sl(consoleLock);
+
+                if (ok)
+                {
+                    samplesRendered += length;
+                    audioSeconds += (double)length / sampleRate;
+                    std::cout << "ok    " << input.getFileName() << "  " << length << " samples, "
+                              << juce::String((double)length / sampleRate / juce::jmax(seconds, 1.0e-6), 1) << "x realtime\n";
+                }
+                else
+                {
+                    ++failures;
+                    std::cout << "FAIL  " << input.getFileName() << "  " << error << "\n";
+                }
+            }
+        }
+
+        juce::int64 samplesRendered = 0;
+        double audioSeconds = 0.0;
+        int failures = 0;
+
+        const KwireAudioProcessor& getProcessor() const { return *processor; }
+
+    private:
+        bool renderFile(const juce::File& input, juce::int64& length, double& sampleRate, juce::String& error)
+        {
+            std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(input));
+
+            if (reader == nullptr)
+            {
+                error = "unreadable or unsupported format";
+                return false;
+            }
+
+            auto numChannels = (int)reader->numChannels;
+            sampleRate = reader->sampleRate;
+            length = reader->lengthInSamples;
+
+            //match the processor's main buses to the file, leaving the sidechain as it is
+            auto layout = processor->getBusesLayout();
+            auto channelSet = juce::AudioChannelSet::canonicalChannelSet(numChannels);
+            layout.inputBuses.getReference(0) = channelSet;
+            layout.outputBuses.getReference(0) = channelSet;
+
+            if (channelSet.isDisabled() || !processor->setBusesLayout(layout))
+            {
+                error = juce::String(numChannels) + " channels not supported";
+                return false;
+            }
+
+            processor->setRateAndBufferSizeDetails(sampleRate, settings.blockSize);
+            processor->prepareToPlay(sampleRate, settings.blockSize);
+            processor->reset();
+
+            //output file
+            auto* format = settings.format.isNotEmpty() ? formatManager.findFormatForFileExtension(settings.format)
+                                                        : formatManager.findFormatForFileExtension(input.getFileExtension());
+
+            if (format == nullptr)
+                format = formatManager.findFormatForFileExtension("wav");
+
+            auto outputDir = settings.outputDir != juce::File() ? settings.outputDir : input.getParentDirectory();
+            auto output = outputDir.getChildFile(input.getFileNameWithoutExtension() + settings.suffix + format->getFileExtensions()[0]);
+
+            outputDir.createDirectory();
+            output.deleteFile();
+
+            std::unique_ptr<juce::OutputStream> stream(output.createOutputStream());
+            auto bits = settings.bitDepth > 0 ? settings.bitDepth : (int)reader->bitsPerSample;
+            std::unique_ptr<juce::AudioFormatWriter> writer(stream != nullptr ? format->createWriterFor(stream.get(), sampleRate, (unsigned int)numChannels, bits, {}, 0) : nullptr);
+
+            if (writer == nullptr)
+            {
+                error = "could not write " + output.getFullPathName();
+                return false;
+            }
+
+            stream.release(); //owned by the writer now
+
+            //stream through in fixed blocks, dropping the first latency samples and flushing the same amount at the end
+            juce::AudioBuffer<float> buffer(numChannels, settings.blockSize);
+            juce::MidiBuffer midi;
+            juce::int64 readPos = 0, written = 0;
+            int toSkip = processor->getLatencySamples();
+
+            while (written < length && !threadShouldExit())
+            {
+                buffer.clear();
+
+                if (readPos < length)
+                {
+                    auto count = (int)juce::jmin((juce::int64)settings.blockSize, length - readPos);
+                    reader->read(&buffer, 0, count, readPos, true, true);
+                    readPos += count;
+                }
+
+                processor->processBlock(buffer, midi);
+
+                auto skipped = juce::jmin(toSkip, settings.blockSize);
+                toSkip -= skipped;
+
+                auto count = (int)juce::jmin((juce::int64)(settings.blockSize - skipped), length - written);
+
+                if (count > 0 && !writer->writeFromAudioSampleBuffer(buffer, skipped, count))
+                {
+                    error = "write failed";
+                    return false;
+                }
+
+                written += juce::jmax(0, count);
+            }
+
+            processor->releaseResources();
+            return true;
+        }
+
+        const RenderSettings& settings;
+        std::unique_ptr<KwireAudioProcessor> processor;
+        juce::AudioFormatManager formatManager;
+        std::atomic<int>& nextFile;
+        juce::CriticalSection& consoleLock;
+    };
+
+   #if KWIRE_PROFILING
+    //One process per worker's processor, with its latest blocks. Opens in ui.perfetto.dev or chrome://tracing.
+    bool writeTrace(const juce::File& file, const juce::OwnedArray<RenderWorker>& workers)
+    {
+        file.deleteFile();
+        juce::FileOutputStream out(file);
+
+        if (!out.openedOk())
+            return false;
+
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+
+        for (auto* worker : workers)
+            worker->getProcessor().profiler.writeTraceEvents(out, first);
+
+        out << "\n]}\n";
+        return true;
+    }
+   #endif
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::StringArray args;
+
+    for (int i = 1; i < argc; ++i)
+        args.add(juce::CharPointer_UTF8(argv[i]));
+
+    RenderSettings settings;
+    juce::String error;
+
+    if (args.isEmpty() || args.contains("--help"))
+    {
+        printUsage();
+        return args.isEmpty() ? 1 : 0;
+    }
+
+    if (!parseArgs(args, settings, error))
+    {
+        std::cerr << error << "\n\n";
+        printUsage();
+        return 1;
+    }
+
+    //processors are created here on the main thread, then handed to their workers
+    std::atomic<int> nextFile { 0 };
+    juce::CriticalSection consoleLock;
+    juce::OwnedArray<RenderWorker> workers;
+
+    for (int i = 0; i < juce::jmin(settings.numThreads, settings.inputs.size()); ++i)
+    {
+        auto processor = std::make_unique<KwireAudioProcessor>();
+
+        if (!applySettings(*processor, settings, error))
+        {
+            std::cerr << error << "\n";
+            return 1;
+        }
+
+        workers.add(new RenderWorker(settings, std::move(processor), nextFile, consoleLock));
+    }
+
+    auto start = juce::Time::getMillisecondCounterHiRes();
+
+    for (auto* worker : workers)
+        worker->startThread();
+
+    for (auto* worker : workers)
+        worker->waitForThreadToExit(-1);
+
+    auto seconds = (juce::Time::getMillisecondCounterHiRes() - start) * 0.001;
+
+    juce::int64 samples = 0;
+    double audioSeconds = 0.0;
+    int failures = 0;
+
+    for (auto* worker : workers)
+    {
+        samples += worker->samplesRendered;
+        audioSeconds += worker->audioSeconds;
+        failures += worker->failures;
+    }
+
+   #if KWIRE_PROFILING
+    if (settings.traceFile != juce::File() && !writeTrace(settings.traceFile, workers))
+    {
+        std::cerr << "Could not write " << settings.traceFile.getFullPathName() << "\n";
+        ++failures;
+    }
+   #endif
+
+    std::cout << "\n" << settings.inputs.size() - failures << "/" << settings.inputs.size() << " files, "
+              << samples << " samples in " << juce::String(seconds, 2) << " s ("
+              << juce::String(audioSeconds / juce::jmax(seconds, 1.0e-6), 1) << "x realtime, "
+              << workers.size() << " workers)\n";
+
+    return failures > 0 ? 1 : 0;
+}
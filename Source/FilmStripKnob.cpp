@@ -1,20 +1,71 @@
 #include "FilmStripKnob.h"
 
-void FilmStripKnob::paint(Graphics& g) {
-    if (isHorizontal) {
-        g.drawImage(filmStrip, 0, 0, getWidth(), getHeight(),
-            static_cast<int>(stripPos * frameWidth), 0, static_cast<int>(frameWidth), static_cast<int>(frameHeight));
-    }
-    else {
-        g.drawImage(filmStrip, 0, 0, getWidth(), getHeight(),
-            0, static_cast<int>(stripPos * frameHeight), static_cast<int>(frameWidth), static_cast<int>(frameHeight));
+FilmStripFrames::FilmStripFrames(const Image& strip_, int numFrames_, bool isHorizontal_, int width_, int height_)
+    : strip(strip_),
+    numFrames(numFrames_),
+    isHorizontal(isHorizontal_),
+    width(width_),
+    height(height_),
+    frames((size_t)numFrames_)
+{
+}
+
+const Image& FilmStripFrames::getFrame(int index) {
+    index = jlimit(0, numFrames - 1, index);
+    auto& frame = frames[(size_t)index];
+
+    if (frame.isNull())
+    {
+        auto frameWidth = isHorizontal ? strip.getWidth() / numFrames : strip.getWidth();
+        auto frameHeight = isHorizontal ? strip.getHeight() : strip.getHeight() / numFrames;
+
+        frame = Image(Image::ARGB, width, height, true);
+
+        Graphics g(frame);
+        g.setImageResamplingQuality(Graphics::highResamplingQuality);
+        g.drawImage(strip, 0, 0, width, height,
+            isHorizontal ? index * frameWidth : 0, isHorizontal ? 0 : index * frameHeight, frameWidth, frameHeight);
     }
 
+    return frame;
+}
+
+bool FilmStripFrames::matches(const Image& otherStrip, int otherWidth, int otherHeight) const {
+    return strip == otherStrip && width == otherWidth && height == otherHeight;
+}
+
+FilmStripFrames::Ptr FilmStripFrameCache::get(const Image& strip, int numFrames, bool isHorizontal, int width, int height) {
+    //drop sets no knob uses any more, e.g. after a resize
+    for (int i = sets.size(); --i >= 0;)
+        if (sets.getObjectPointerUnchecked(i)->getReferenceCount() == 1)
+            sets.remove(i);
+
+    for (auto* set : sets)
+        if (set->matches(strip, width, height))
+            return set;
+
+    return sets.add(new FilmStripFrames(strip, numFrames, isHorizontal, width, height));
+}
+
+void FilmStripKnob::paint(Graphics& g) {
+    //frames are cached in physical pixels, so they are drawn without resampling
+    auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    auto width = roundToInt((float)getWidth() * scale),
+        height = roundToInt((float)getHeight() * scale);
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (frames == nullptr || !frames->matches(filmStrip, width, height))
+        frames = frameCache->get(filmStrip, numFrames, isHorizontal, width, height);
+
+    g.drawImage(frames->getFrame(stripPos), getLocalBounds().toFloat());
+
     if (isMouseOverOrDragging() && showText)
     {
         g.setFont(static_cast<float>(getLocalBounds().getHeight()) * textBoxSize);
-        juce::Rectangle<float> textSpace = Rectangle<float>::Rectangle(0.15 * this->getWidth(), (1.0f - textBoxSize) * this->getHeight(), 0.70 * this->getWidth(), textBoxSize * this->getHeight());
-        juce::Rectangle<int> textSpace_ = Rectangle<int>::Rectangle(0.15 * this->getWidth(), (1.0f - textBoxSize) * this->getHeight(), 0.70 * this->getWidth(), textBoxSize * this->getHeight());
+        juce::Rectangle<float> textSpace = Rectangle<float>(0.15 * this->getWidth(), (1.0f - textBoxSize) * this->getHeight(), 0.70 * this->getWidth(), textBoxSize * this->getHeight());
+        juce::Rectangle<int> textSpace_ = Rectangle<int>(0.15 * this->getWidth(), (1.0f - textBoxSize) * this->getHeight(), 0.70 * this->getWidth(), textBoxSize * this->getHeight());
 
         g.setColour(boxFillColour);
         g.setOpacity(transparency);
@@ -23,6 +74,14 @@ void FilmStripKnob::paint(Graphics& g) {
         g.setColour(boxRimColour);
         g.drawRect(textSpace);
 
+        if (valueStringIsStale)
+        {
+            valueString = std::to_string(this->getValue()); //slider value as a string
+            valueString = valueString.dropLastCharacters(stringLengthToRemove);
+            valueString.append(suffix, 10);
+            valueStringIsStale = false;
+        }
+
         g.setColour(textColour);
         g.drawFittedText(valueString, textSpace_, juce::Justification::centred, 2, 0.5f);
     }
@@ -44,10 +103,8 @@ void FilmStripKnob::setColours(const juce::Colour& boxRim, const juce::Colour& b
 }
 
 void FilmStripKnob::valueChanged() {
-    //Change value string
-    valueString = std::to_string(this->getValue()); //slider value as a string
-    valueString = valueString.dropLastCharacters(stringLengthToRemove);
-    valueString.append(suffix, 10);
+    //Value string is only needed while the text box shows
+    valueStringIsStale = true;
 
     //Get new film strip position
     stripPos = roundDoubleToInt(valueToProportionOfLength(this->getValue()) * static_cast<double>(numFrames - 1));
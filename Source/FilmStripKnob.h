@@ -2,6 +2,38 @@
 #include <JuceHeader.h>
 using namespace juce;
 
+/// Frames of a film strip scaled to one size in physical pixels. Each frame is scaled the first time it is drawn.
+class FilmStripFrames : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<FilmStripFrames>;
+
+    FilmStripFrames(const Image& strip, int numFrames, bool isHorizontal, int width, int height);
+
+    const Image& getFrame(int index);
+
+    bool matches(const Image& otherStrip, int otherWidth, int otherHeight) const;
+
+private:
+    const Image strip;
+    const int numFrames;
+    const bool isHorizontal;
+    const int width,
+        height;
+
+    std::vector<Image> frames;
+};
+
+/// Frame sets in use, shared through SharedResourcePointer so knobs of the same size showing the same strip scale it once
+class FilmStripFrameCache
+{
+public:
+    FilmStripFrames::Ptr get(const Image& strip, int numFrames, bool isHorizontal, int width, int height);
+
+private:
+    ReferenceCountedArray<FilmStripFrames> sets;
+};
+
 class FilmStripKnob : public Slider
 {
 public:
@@ -28,10 +60,10 @@ public:
             frameWidth = filmStrip.getWidth();
         }
 
-        valueString = std::to_string(this->getValue());
+        valueChanged();
     }
 
-    void paint(Graphics& g);
+    void paint(Graphics& g) override;
 
     /// Set whether to show value on mouse hover. textSize (0 - 1) sets how large the value's text box is relative to the knob.
     void showValue(const bool& showValueOnHover, const float& textSize);
@@ -47,8 +79,9 @@ public:
     int getFrameHeight() const { return frameHeight; }
 
 private:
-    int stripPos;
+    int stripPos = 0;
     bool showText;
+    bool valueStringIsStale = true; //formatted on the next paint that shows it
     String valueString;
     float textBoxSize;
     float frameWidth,
@@ -64,4 +97,7 @@ private:
     juce::Colour boxRimColour,
         boxFillColour,
         textColour;
-};
\ No newline at end of file
+
+    SharedResourcePointer<FilmStripFrameCache> frameCache;
+    FilmStripFrames::Ptr frames; //for the current size and display scale
+};
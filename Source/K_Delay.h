@@ -0,0 +1,76 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+using namespace juce;
+
+//Whole-sample delay on a circular buffer, float or double. Memory is allocated in prepare() only.
+template <typename SampleType = float>
+class K_Delay {
+public:
+	K_Delay() {
+	}
+
+	void prepare(int numChannels, int maxDelayInSamples) {
+		maxDelay = jmax(1, maxDelayInSamples);
+		ring.setSize(numChannels, maxDelay);
+		setDelay(jmin(delay, maxDelay));
+	}
+
+	//Clears the buffer, so only call this when the delay actually changes
+	void setDelay(int delayInSamples) {
+		jassert(isPositiveAndNotGreaterThan(delayInSamples, maxDelay));
+		delay = jlimit(0, maxDelay, delayInSamples);
+		reset();
+	}
+
+	int getDelay() const { return delay; }
+
+	int getMaxDelay() const { return maxDelay; }
+
+	void reset() {
+		ring.clear();
+		writePos = 0;
+	}
+
+	//output may be the same as input
+	void process(const SampleType* const* input, SampleType* const* output, int numChannels, int numSamples) {
+		jassert(numChannels <= ring.getNumChannels());
+
+		if (delay == 0) {
+			for (int channel = 0; channel < numChannels; ++channel)
+				if (output[channel] != input[channel])
+					FloatVectorOperations::copy(output[channel], input[channel], numSamples);
+
+			return;
+		}
+
+		int pos = writePos;
+
+		for (int channel = 0; channel < numChannels; ++channel) {
+			SampleType* ringData = ring.getWritePointer(channel);
+			pos = writePos;
+
+			//the ring is exactly one delay long, so each slot is read before it is overwritten
+			for (int done = 0; done < numSamples;) {
+				const int count = jmin(numSamples - done, delay - pos);
+
+				for (int i = 0; i < count; ++i) {
+					const SampleType delayed = ringData[pos + i];
+					ringData[pos + i] = input[channel][done + i];
+					output[channel][done + i] = delayed;
+				}
+
+				done += count;
+				pos = (pos + count) % delay;
+			}
+		}
+
+		writePos = pos;
+	}
+
+private:
+	AudioBuffer<SampleType> ring;
+
+	int maxDelay = 1,
+		delay = 0,
+		writePos = 0;
+};
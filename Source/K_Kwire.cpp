@@ -0,0 +1,82 @@
+#include "K_Kwire.h"
+
+namespace K_Simd {
+	namespace scalar {
+		#include "K_KwireKernels.h"
+	}
+
+#if KWIRE_SIMD_X86
+	namespace sse2 {
+		#include "K_KwireKernels.h"
+	}
+
+	KWIRE_BEGIN_AVX2
+	namespace avx2 {
+		#include "K_KwireKernels.h"
+	}
+	KWIRE_END_AVX2
+#endif
+
+#if KWIRE_SIMD_NEON
+	namespace neon {
+		#include "K_KwireKernels.h"
+	}
+#endif
+
+	//The function templates are instantiated for Sample here, the overloaded ones picked by the pointer types
+	template <typename Sample>
+	const Kernels<Sample>& getKernels(InstructionSet set) {
+		static const Kernels<Sample> scalarKernels { &scalar::compress<Sample>, &scalar::overdrive<Sample>, &scalar::linkDetector<Sample>, &scalar::applyGain, &scalar::mixAndGain };
+
+		switch (set) {
+		case InstructionSet::scalar:
+			return scalarKernels;
+#if KWIRE_SIMD_X86
+		case InstructionSet::sse2: {
+			static const Kernels<Sample> kernels { &sse2::compress<Sample>, &sse2::overdrive<Sample>, &sse2::linkDetector<Sample>, &sse2::applyGain, &sse2::mixAndGain };
+			return kernels;
+		}
+		case InstructionSet::avx2: {
+			static const Kernels<Sample> kernels { &avx2::compress<Sample>, &avx2::overdrive<Sample>, &avx2::linkDetector<Sample>, &avx2::applyGain, &avx2::mixAndGain };
+			return kernels;
+		}
+		case InstructionSet::neon:
+			break;
+#elif KWIRE_SIMD_NEON
+		case InstructionSet::neon: {
+			static const Kernels<Sample> kernels { &neon::compress<Sample>, &neon::overdrive<Sample>, &neon::linkDetector<Sample>, &neon::applyGain, &neon::mixAndGain };
+			return kernels;
+		}
+		case InstructionSet::sse2:
+		case InstructionSet::avx2:
+			break;
+#else
+		case InstructionSet::sse2:
+		case InstructionSet::avx2:
+		case InstructionSet::neon:
+			break;
+#endif
+		}
+
+		//an instruction set this build has no kernels for
+		jassertfalse;
+		return scalarKernels;
+	}
+
+	template const Kernels<float>& getKernels<float>(InstructionSet);
+	template const Kernels<double>& getKernels<double>(InstructionSet);
+
+	const float* getShaperTable() {
+		static const std::vector<float> table = [] {
+			//two guard points so interpolation at the top of the range stays in bounds
+			std::vector<float> values(shaperTableSize + 2);
+
+			for (size_t i = 0; i < values.size(); ++i)
+				values[i] = scalar::positiveCurve(jmin((float)i, (float)shaperTableSize) * (shaperTableRange / shaperTableSize));
+
+			return values;
+		}();
+
+		return table.data();
+	}
+}
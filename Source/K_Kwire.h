@@ -1,48 +1,366 @@
 #pragma once
-#include <JuceHeader.h>
+#include <juce_dsp/juce_dsp.h>
+#include "K_Simd.h"
+#include "K_Delay.h"
+#include "K_WindowMax.h"
+#include "K_Profiler.h"
 using namespace juce;
 
-template<int chNum>
+namespace K_Simd {
+	//Per-block compressor constants, precomputed so the vector kernels only multiply
+	struct CompressorCoeffs {
+		float threshold,
+			slope, //1 - 1/ratio
+			knee,
+			invKnee,
+			attack, //1 / envelope steps
+			release,
+			thresholdLog2, //threshold and knee in log2 units, for the fast detector
+			kneeLog2,
+			invKneeLog2;
+	};
+
+	struct OverdriveCoeffs {
+		float driveEnv, //1 / envelope steps
+			driveSlow,
+			driveFast, //used while the preliminary envelope is out of clipping territory
+			dryAmt,
+			wetAmt;
+	};
+
+	//Start values and per-sample increments of the output stage's ramps
+	struct OutputCoeffs {
+		float mixStart,
+			mixStep,
+			gainStart,
+			gainStep;
+	};
+
+	//Shaper table: positive half of the static curve, sampled over [0, shaperTableRange]. Flat above that.
+	constexpr int shaperTableSize = 4096;
+	constexpr float shaperTableRange = 16.f;
+
+	//Entry points of the vector kernels for one instruction set and sample type, compiled once in K_Kwire.cpp.
+	//Envelopes, gains and detector levels are float either way.
+	template <typename Sample = float>
+	struct Kernels {
+		void (*compress)(Sample* const* channels, const Sample* const* detectors, int numChannels, int numSamples, float* prevEnvelope, float* minGain, const CompressorCoeffs& c, bool fast);
+		void (*overdrive)(Sample* const* channels, int numChannels, int numSamples, float* prevDriveEnv, float* prevDrive, const OverdriveCoeffs& c, const float* table);
+		void (*linkDetector)(const Sample* const* channels, int numChannels, int numSamples, float* level, bool mean);
+		void (*applyGain)(Sample* const* channels, int numChannels, int numSamples, const float* gain);
+		void (*mixAndGain)(Sample* wet, const Sample* dry, int numSamples, const OutputCoeffs& c, float& wetSumOfSquares, float& wetPeak);
+	};
+
+	//Scalar gives the generic one-lane kernels. Only ask for instruction sets that isAvailable().
+	template <typename Sample = float>
+	const Kernels<Sample>& getKernels(InstructionSet set);
+
+	extern template const Kernels<float>& getKernels<float>(InstructionSet);
+	extern template const Kernels<double>& getKernels<double>(InstructionSet);
+
+	//Shared by all instances, built on first use
+	const float* getShaperTable();
+
+	//Largest error of the interpolated table against the exact curve, measured densely over its whole range
+	constexpr float shaperTableMaxError = 2.6e-5f;
+}
+
+//How the compressor turns the signal into an attenuation
+enum class K_DetectorMode {
+	exact, //Decibels conversions
+	fast //log2 domain with low order approximations, within 0.003 dB of exact
+};
+
+//How the channels share the compressor's detector
+enum class K_LinkMode {
+	off, //every channel follows its own level
+	max, //one envelope for all channels, following the loudest
+	mean //one envelope for all channels, following the mean level
+};
+
+//How the static part of the overdrive curve is evaluated
+enum class K_ShaperMode {
+	exact,
+	table //linearly interpolated lookup, within K_Simd::shaperTableMaxError (2.6e-5) of exact
+};
+
+//Exact comparison, for values that are copied rather than worked out, where "changed at all" is the question
+JUCE_BEGIN_IGNORE_WARNINGS_GCC_LIKE("-Wfloat-equal")
+inline bool K_exactlyEqual(float a, float b) {
+	return a == b;
+}
+JUCE_END_IGNORE_WARNINGS_GCC_LIKE
+
+//Control values for one block, read once from the parameters. The engine ramps towards each new snapshot.
+struct K_KwireParams {
+	float ratio, //1 to 2
+		threshold, //dB
+		attack, //ms
+		release; //ms
+
+	bool operator==(const K_KwireParams& other) const {
+		return K_exactlyEqual(ratio, other.ratio) && K_exactlyEqual(threshold, other.threshold)
+			&& K_exactlyEqual(attack, other.attack) && K_exactlyEqual(release, other.release);
+	}
+
+	bool operator!=(const K_KwireParams& other) const { return !(*this == other); }
+};
+
+//maxChNum sizes the per-channel state. The channels actually processed are set at runtime with setNumChannels().
+//SampleType is float or double. With double the signal path stays in double, while the envelopes, the detector
+//and the overdrive's shaping run in float (the float kernels' lanes), which is well below what they can resolve anyway.
+template<int maxChNum, typename SampleType = float>
 class K_Kwire{
 public:
 	K_Kwire() {
+		setNumChannels(maxChNum);
 	}
 
-	void setupParams(float initRatio, float initThreshold, float initAttack, float initRelease, double initSampleRate){
+	//Channels to process, 1 to maxChNum. Picks the instruction set for that width and clears the envelopes,
+	//so call it before processing starts (prepareToPlay) and force an instruction set afterwards.
+	void setNumChannels(int newNumChannels) {
+		jassert(newNumChannels > 0 && newNumChannels <= maxChNum);
+
+		numChannels = jlimit(1, maxChNum, newNumChannels);
+		setInstructionSet(K_Simd::getBestInstructionSet(numChannels));
+
+		//the lookahead buffers were sized for fewer channels, prepareLookahead() again
+		if (numChannels > (int)windowMax.size())
+			lookahead = 0;
+
+		reset();
+	}
+
+	int getNumChannels() const { return numChannels; }
+
+	//Sets the engine rate and jumps straight to initParams, no ramp
+	void setupParams(const K_KwireParams& initParams, double initSampleRate){
 		sampleRate = initSampleRate;
-		ratio = initRatio;
-		threshold = initThreshold;
-		attackInSamps = initAttack * sampleRate * 0.001;
-		releaseInSamps = initRelease * sampleRate * 0.001;
 		driveTime = driveTimeInMS * sampleRate * 0.001;
+
+		ratioRamp.reset(sampleRate, rampTimeInSeconds);
+		thresholdRamp.reset(sampleRate, rampTimeInSeconds);
+		ratioRamp.setCurrentAndTargetValue(initParams.ratio);
+		thresholdRamp.setCurrentAndTargetValue(initParams.threshold);
+
+		params = initParams;
+		setEnvelopeTimes(params);
+		ratio = initParams.ratio;
+		threshold = initParams.threshold;
+		updateCoeffs();
 	}
 
-	inline void updateParams(float inRatio, float inThreshold, float inAttack, float inRelease) {
-		ratio = inRatio;
-		threshold = inThreshold;
-		attackInSamps = inAttack * sampleRate * 0.001;
-		releaseInSamps = inRelease * sampleRate * 0.001;
+	//Once per block, before process(). Ratio and threshold ramp to the new values at control rate, the envelope times
+	//switch at the next control step. Nothing is recalculated while the snapshot stays the same.
+	inline void setParams(const K_KwireParams& newParams) {
+		if (newParams == params)
+			return;
+
+		ratioRamp.setTargetValue(newParams.ratio);
+		thresholdRamp.setTargetValue(newParams.threshold);
+
+		if (!K_exactlyEqual(newParams.attack, params.attack) || !K_exactlyEqual(newParams.release, params.release))
+			setEnvelopeTimes(newParams);
+
+		params = newParams;
+		coeffsDirty = true;
 	}
+
+	const K_KwireParams& getParams() const { return params; }
+
+	//Allocates the lookahead delay and detector for up to maxLookaheadInSamples at the engine rate. Call after setNumChannels().
+	void prepareLookahead(int maxLookaheadInSamples) {
+		lookaheadDelay.prepare(numChannels, maxLookaheadInSamples);
+		windowMax.resize((size_t)numChannels);
+
+		for (auto& window : windowMax)
+			window.prepare(maxLookaheadInSamples + 1);
+
+		setLookahead(jmin(lookahead, maxLookaheadInSamples));
+	}
+
+	//Delays the signal by lookaheadInSamples (engine rate) and lets the detector see that far ahead,
+	//so the envelope is already down when a transient arrives. Clears the delay, so only call it when the value changes.
+	void setLookahead(int lookaheadInSamples) {
+		jassert(lookaheadInSamples == 0 || !windowMax.empty());
+
+		lookahead = windowMax.empty() ? 0 : jlimit(0, lookaheadDelay.getMaxDelay(), lookaheadInSamples);
+		lookaheadDelay.setDelay(lookahead);
+
+		for (auto& window : windowMax)
+			window.setWindow(lookahead + 1);
+	}
+
+	int getLookahead() const { return lookahead; }
+
+	//Clears the envelopes back to their initial state
+	void reset() {
+		std::fill(prevEnvelope, prevEnvelope + paddedChannels, 0.f);
+		std::fill(prevDrive, prevDrive + paddedChannels, 0.f);
+		std::fill(prevDriveEnv, prevDriveEnv + paddedChannels, 0.f);
+		std::fill(minGain, minGain + paddedChannels, 1.f);
+
+		lookaheadDelay.reset();
+
+		for (auto& window : windowMax)
+			window.reset();
+	}
+
+	//Whether silence has taken the envelopes as far as it will: within restTolerance of unity gain and no drive,
+	//or so close that a float step no longer moves them. Skipping silence from here changes nothing.
+	bool isAtRest() const {
+		const int envelopes = linkMode == K_LinkMode::off ? numChannels : 1;
+
+		for (int channel = 0; channel < envelopes; ++channel) {
+			const float level = prevEnvelope[channel];
+
+			if (level < 1.f - restTolerance && !K_exactlyEqual(level + (1.f - level) * coeffs.release, level))
+				return false;
+		}
+
+		for (int channel = 0; channel < numChannels; ++channel)
+			if (prevDrive[channel] > restTolerance || prevDriveEnv[channel] > restTolerance)
+				return false;
+
+		return true;
+	}
+
+	//Stands in for process() over numSamples engine samples of silence once isAtRest() and the lookahead has been flushed:
+	//nothing to compute, but the control-rate ramps move on as if the samples had been processed
+	void idle(int numSamples) {
+		jassert(isAtRest());
+
+		std::fill(minGain, minGain + paddedChannels, 1.f);
+
+		while (numSamples > 0) {
+			if (samplesToControlStep == 0) {
+				advanceParams(controlInterval);
+				samplesToControlStep = controlInterval;
+			}
+
+			const int count = jmin(samplesToControlStep, numSamples);
+
+			samplesToControlStep -= count;
+			numSamples -= count;
+		}
+	}
+
+	//Longest time silence can take to bring the envelopes to rest, in ms of envelope time as the params give them.
+	//The engine rate scales it like the attack and release.
+	static float getSettleTimeMs(const K_KwireParams& p) {
+		const float slowest = jmax(p.release * 1.1f, driveTimeInMS * 0.015f, driveTimeInMS * 0.01f * 1.1f);
+
+		return slowest * std::log(1.f / restTolerance);
+	}
+
+	//Forces an instruction set for the kernels, e.g. to compare against the scalar path. Falls back to scalar if the CPU lacks it.
+	void setInstructionSet(K_Simd::InstructionSet set) {
+		instructionSet = K_Simd::isAvailable(set) ? set : K_Simd::InstructionSet::scalar;
+		kernels = &K_Simd::getKernels<SampleType>(instructionSet);
+		floatKernels = &K_Simd::getKernels<float>(instructionSet);
+	}
+
+	K_Simd::InstructionSet getInstructionSet() const { return instructionSet; }
+
+	void setShaperMode(K_ShaperMode mode) {
+		shaperTable = mode == K_ShaperMode::table ? K_Simd::getShaperTable() : nullptr;
+	}
+
+	void setDetectorMode(K_DetectorMode mode) { fastDetector = mode == K_DetectorMode::fast; }
+
+	K_DetectorMode getDetectorMode() const { return fastDetector ? K_DetectorMode::fast : K_DetectorMode::exact; }
+
+	K_ShaperMode getShaperMode() const { return shaperTable != nullptr ? K_ShaperMode::table : K_ShaperMode::exact; }
+
+	//Safe to change between blocks. The envelope is handed over, so switching doesn't jump.
+	void setLinkMode(K_LinkMode mode) {
+		if (mode == linkMode)
+			return;
+
+		//the linked envelope lives in the first channel's state
+		if (mode == K_LinkMode::off)
+			std::fill(prevEnvelope + 1, prevEnvelope + paddedChannels, prevEnvelope[0]);
+		else if (linkMode == K_LinkMode::off)
+			prevEnvelope[0] = *std::min_element(prevEnvelope, prevEnvelope + numChannels);
+
+		linkMode = mode;
+	}
+
+	K_LinkMode getLinkMode() const { return linkMode; }
+
+#if KWIRE_PROFILING
+	//Where process() times its compress and overdrive stages. Null leaves them untimed.
+	void setProfiler(K_Profiler* newProfiler) { profiler = newProfiler; }
+#endif
+
+	//Lowest gain the compressor applied to a channel during the last process() or compress() call
+	float getMinGain(int channel) const { return minGain[channel]; }
+
+	//Compressor then overdrive, in control-rate segments: the parameter ramps advance and the coefficients are refreshed
+	//every controlInterval engine samples, counted across blocks, so automation steps the same whatever the block size.
+	inline void process(dsp::AudioBlock<SampleType>& block, const dsp::AudioBlock<SampleType>* sidechain = nullptr) {
+		const auto numSamples = block.getNumSamples();
+
+		std::fill(minGain, minGain + paddedChannels, 1.f);
+
+		for (size_t start = 0; start < numSamples;) {
+			if (samplesToControlStep == 0) {
+				advanceParams(controlInterval);
+				samplesToControlStep = controlInterval;
+			}
+
+			const auto count = jmin((size_t)samplesToControlStep, numSamples - start);
+
+			auto segment = block.getSubBlock(start, count);
+
+			{
+				K_PROFILE_STAGE(profiler, K_Stage::compress);
+
+				if (sidechain != nullptr) {
+					auto sidechainSegment = sidechain->getSubBlock(start, count);
+					compressSegment(segment, &sidechainSegment);
+				}
+				else {
+					compressSegment(segment, nullptr);
+				}
+			}
+
+			{
+				K_PROFILE_STAGE(profiler, K_Stage::overdrive);
+				overdrive(segment);
+			}
+
+			samplesToControlStep -= (int)count;
+			start += count;
+		}
+	}
+
+	//The stages on their own, with the current coefficients and no ramping
 	
-	inline void overdrive(dsp::AudioBlock<float>& block){
-		for (int channel = 0; channel < chNum; ++channel) {
+	inline void overdrive(dsp::AudioBlock<SampleType>& block){
+		const int activeChannels = pointAtChannels(block);
 
-			channelData[channel] = block.getChannelPointer(channel);
+		//vector path, or the generic kernel when the table is in use
+		if (instructionSet != K_Simd::InstructionSet::scalar || shaperTable != nullptr)
+			return kernels->overdrive(channelData, activeChannels, (int)block.getNumSamples(), prevDriveEnv, prevDrive, driveCoeffs, shaperTable);
+
+		//scalar fallback
+		for (int channel = 0; channel < activeChannels; ++channel) {
 
 			for (int sample = 0; sample < block.getNumSamples(); ++sample){
 
-				float &input = channelData[channel][sample];
+				SampleType &input = channelData[channel][sample];
 
 				if (input >= 0.0) { //For positive signal values
 					//get preliminar envelope
-					driveEnv[channel] = slide(abs(input), prevDriveEnv[channel], driveTime * 0.015f);
+					driveEnv[channel] = slide((float)std::abs(input), prevDriveEnv[channel], driveCoeffs.driveEnv);
 					prevDriveEnv[channel] = driveEnv[channel];
 
 					//is not in clipping territory
 					bool clip = (driveEnv[channel] < 0.5f);
 
 					//get envelope
-					drive[channel] = slide(abs(0.5f * input), prevDrive[channel], driveTime - 0.99 * driveTime * clip, 1.1);
+					drive[channel] = slide((float)std::abs(0.5f * input), prevDrive[channel], clip ? driveCoeffs.driveFast : driveCoeffs.driveSlow);
 
 					drive[channel] = jlimit(0.f, 1.f, drive[channel]);
 
@@ -51,7 +369,7 @@ public:
 
 					drive[channel] = (drive[channel] * (2.0 - drive[channel])); //logarithmic distribution
 
-					float dry = input; //for dry/wet mix controlled by ratio
+					SampleType dry = input; //for dry/wet mix controlled by ratio
 
 					//Sigmoid
 					input = input * ((27.0f + ((9.0f - 8.2f * drive[channel]) * input * input * 0.8f)) / (27.0f + 9.0f * input * input));
@@ -61,88 +379,246 @@ public:
 					input = input * (float)(input < 0.647f) + 0.9 * (input - 0.1841) * (2.2 - input) * (float)((input > 0.647f) && (input < 1.192f)) + 0.9144 * (float)(input >= 1.192f);
 					input = input * 1.1111111f;
 
-					float &wet = input;
-
-					float dryAmt = 2.0f - ratio;
-					float wetAmt = 1.0f - dryAmt;
+					SampleType &wet = input;
 
-					channelData[channel][sample] = dry * dryAmt + wet * wetAmt;
+					channelData[channel][sample] = dry * driveCoeffs.dryAmt + wet * driveCoeffs.wetAmt;
 
 				} else {
-					float dry = input; //for dry/wet mix controlled by ratio
+					SampleType dry = input; //for dry/wet mix controlled by ratio
 
 					input = -input;
 
 					//Sigmoid
 					input = -1.f * (input * (float)(input < 0.647f) + 0.9 * (input - 0.1841) * (2.2 - input) * (float)((input > 0.647f) && (input < 1.192f)) + 0.9144 * (float)(input >= 1.192f));
 
-					float* wet = &input;
+					SampleType* wet = &input;
 
-					float dryAmt = (2.f - ratio);
-					float wetAmt = (ratio - 1.f); //amount of OD according to ratio
-
-					channelData[channel][sample] = dry * dryAmt + *wet * wetAmt;
+					//amount of OD according to ratio
+					channelData[channel][sample] = dry * driveCoeffs.dryAmt + *wet * driveCoeffs.wetAmt;
 				}
 			}
 		}
 	}
 	
-	inline void compress(dsp::AudioBlock<float>& block) {
-		for (int channel = 0; channel < chNum; ++channel)
-			channelData[channel] = block.getChannelPointer(channel);
+	//sidechain, if given, drives the detector instead of the block. It must be at the same rate and length as the block.
+	//A sidechain with fewer channels is reused across the block's channels, so a mono key drives them all.
+	inline void compress(dsp::AudioBlock<SampleType>& block, const dsp::AudioBlock<SampleType>* sidechain = nullptr) {
+		std::fill(minGain, minGain + paddedChannels, 1.f);
+
+		compressSegment(block, sidechain);
+	}
+
+private:
+	//Lowers minGain rather than starting it over, so segments of one block add up
+	inline void compressSegment(dsp::AudioBlock<SampleType>& block, const dsp::AudioBlock<SampleType>* sidechain) {
+		const int activeChannels = pointAtChannels(block);
+		const int numSamples = (int)block.getNumSamples();
+
+		const SampleType* const* detectors = channelData;
+		int numDetectors = activeChannels;
+
+		if (sidechain != nullptr && sidechain->getNumChannels() > 0) {
+			jassert((int)sidechain->getNumSamples() == numSamples);
+
+			numDetectors = jmin(maxChNum, (int)sidechain->getNumChannels());
+
+			for (int channel = 0; channel < jmax(activeChannels, numDetectors); ++channel)
+				detectorData[channel] = sidechain->getChannelPointer((size_t)(channel % numDetectors));
+
+			detectors = detectorData;
+		}
+
+		if (linkMode != K_LinkMode::off || lookahead > 0)
+			return compressChunked(detectors, numDetectors, activeChannels, numSamples);
+
+		//vector path: all channels of a sample in one register. The fast detector and the sidechain need the generic kernel on scalar.
+		if (instructionSet != K_Simd::InstructionSet::scalar || fastDetector || detectors != channelData)
+			return kernels->compress(channelData, detectors, activeChannels, numSamples, prevEnvelope, minGain, coeffs, fastDetector);
 
-		for (int channel = 0; channel < chNum; ++channel) {
-			for (int sample = 0; sample < block.getNumSamples(); ++sample)
+		//scalar fallback
+		for (int channel = 0; channel < activeChannels; ++channel) {
+			for (int sample = 0; sample < numSamples; ++sample)
 			{
 				//attenuation calculation
-				rawAttenuation[channel] = calcAttenuation((ratio - 1.0f) * 3.0f + 1.0f, threshold, Decibels::gainToDecibels(abs(channelData[channel][sample])), compKnee);
+				rawAttenuation[channel] = calcAttenuation((float)Decibels::gainToDecibels(std::abs(channelData[channel][sample])));
 
 				//envelope follower
 				if (rawAttenuation[channel] > prevEnvelope[channel]) //release
-					envelope[channel] = slide(rawAttenuation[channel], prevEnvelope[channel], releaseInSamps, 1.1f);
+					envelope[channel] = slide(rawAttenuation[channel], prevEnvelope[channel], coeffs.release);
 				else //attack
-					envelope[channel] = slide(rawAttenuation[channel], prevEnvelope[channel], attackInSamps, 1.1f);
+					envelope[channel] = slide(rawAttenuation[channel], prevEnvelope[channel], coeffs.attack);
 
 				prevEnvelope[channel] = envelope[channel];
+				minGain[channel] = jmin(minGain[channel], envelope[channel]);
 
 				channelData[channel][sample] *= envelope[channel];
 			}
 		}
 	}
 
-private:
-	//No knee
-	inline float calcAttenuation(const float &ratio, const float &threshold, const float &signalInDB) {
+	//Points channelData at the block. A block narrower than numChannels (e.g. mono through a stereo setup) only processes what it has.
+	inline int pointAtChannels(dsp::AudioBlock<SampleType>& block) {
+		const int activeChannels = jmin(numChannels, (int)block.getNumChannels());
+
+		for (int channel = 0; channel < activeChannels; ++channel)
+			channelData[channel] = block.getChannelPointer(channel);
+
+		return activeChannels;
+	}
+
+	//Linked detector and/or lookahead, through fixed chunks so the detector buffers stay small.
+	//Linked: a single envelope, kept in the first channel's state, follows the combined level and the same gain goes onto every channel.
+	//Lookahead: the detector takes the loudest sample of the next lookahead samples, while the channels are delayed by as much.
+	void compressChunked(const SampleType* const* detectors, int numDetectors, int activeChannels, int numSamples) {
+		const bool linked = linkMode != K_LinkMode::off;
+
+		const SampleType* sources[(size_t)maxChNum];
+		const float* levels[(size_t)maxChNum];
+		SampleType* targets[(size_t)maxChNum];
+		float* gains[(size_t)maxChNum];
+
+		for (int channel = 0; channel < maxChNum; ++channel)
+			gains[channel] = detectorGain[channel];
+
+		for (int start = 0; start < numSamples; start += detectorChunkSize) {
+			const int count = jmin(detectorChunkSize, numSamples - start);
+
+			for (int channel = 0; channel < jmax(numDetectors, activeChannels); ++channel)
+				sources[channel] = detectors[channel] + start;
+
+			for (int channel = 0; channel < activeChannels; ++channel)
+				targets[channel] = channelData[channel] + start;
+
+			if (linked) {
+				kernels->linkDetector(sources, numDetectors, count, detectorLevel[0], linkMode == K_LinkMode::mean);
+
+				if (lookahead > 0)
+					windowMax[0].process(detectorLevel[0], detectorLevel[0], count);
+
+				levels[0] = detectorLevel[0];
+			}
+			else {
+				//only reached with lookahead
+				for (int channel = 0; channel < activeChannels; ++channel) {
+					windowMax[(size_t)channel].process(sources[channel], detectorLevel[channel], count);
+					levels[channel] = detectorLevel[channel];
+				}
+			}
+
+			//the detector has read this chunk, now the signal can fall behind it
+			if (lookahead > 0)
+				lookaheadDelay.process(targets, targets, activeChannels, count);
+
+			//the keyed kernel multiplies into its channel, so starting from unity leaves the bare envelope
+			if (linked) {
+				std::fill(detectorGain[0], detectorGain[0] + count, 1.f);
+				floatKernels->compress(gains, levels, 1, count, prevEnvelope, minGain, coeffs, fastDetector);
+				kernels->applyGain(targets, activeChannels, count, detectorGain[0]);
+			}
+			else if constexpr (std::is_same<SampleType, float>::value) {
+				kernels->compress(targets, levels, activeChannels, count, prevEnvelope, minGain, coeffs, fastDetector);
+			}
+			else {
+				//the levels are float, so the gains are worked out on their own and applied to the double channels after
+				for (int channel = 0; channel < activeChannels; ++channel)
+					std::fill(detectorGain[channel], detectorGain[channel] + count, 1.f);
+
+				floatKernels->compress(gains, levels, activeChannels, count, prevEnvelope, minGain, coeffs, fastDetector);
+
+				for (int channel = 0; channel < activeChannels; ++channel)
+					kernels->applyGain(targets + channel, 1, count, detectorGain[channel]);
+			}
+		}
+
+		if (linked)
+			std::fill(minGain + 1, minGain + paddedChannels, minGain[0]);
+	}
 
-		return 1.f + (signalInDB > threshold) * -(1.f - Decibels::decibelsToGain((threshold - signalInDB) * (1.f - (1.f / ratio))));
+	inline void setEnvelopeTimes(const K_KwireParams& times) {
+		attackInSamps = times.attack * sampleRate * 0.001;
+		releaseInSamps = times.release * sampleRate * 0.001;
 	}
 
-	//Soft knee
-	inline float calcAttenuation(const float& ratio, const float& threshold, const float& signalInDB, const float &kneeInDbs) {
+	//Control rate: steps the ramps on and refreshes the coefficients if anything changed
+	inline void advanceParams(int numSamples) {
+		if (!coeffsDirty && !ratioRamp.isSmoothing() && !thresholdRamp.isSmoothing())
+			return;
+
+		ratio = ratioRamp.skip(numSamples);
+		threshold = thresholdRamp.skip(numSamples);
+		coeffsDirty = ratioRamp.isSmoothing() || thresholdRamp.isSmoothing();
 
-		//auto knee = 1.f - (jlimit(0.f, kneeInDbs, threshold - signalInDB) / kneeInDbs);
+		updateCoeffs();
+	}
 
-		return 1.f + (1.f - (jlimit(0.f, kneeInDbs, threshold - signalInDB) / kneeInDbs)) *
-			-(1.f - Decibels::decibelsToGain((threshold - signalInDB) * (1.f - (1.f / ratio))));
+	//All the divisions live here, so the sample loops only multiply
+	inline void updateCoeffs() {
+		coeffs.threshold = threshold;
+		coeffs.slope = 1.f - (1.f / ((ratio - 1.0f) * 3.0f + 1.0f));
+		coeffs.knee = compKnee;
+		coeffs.invKnee = 1.f / compKnee;
+		coeffs.attack = 1.f / (attackInSamps * 1.1f);
+		coeffs.release = 1.f / (releaseInSamps * 1.1f);
+		coeffs.thresholdLog2 = threshold / 6.0205999f;
+		coeffs.kneeLog2 = compKnee / 6.0205999f;
+		coeffs.invKneeLog2 = 6.0205999f / compKnee;
+
+		driveCoeffs.driveEnv = 1.f / (driveTime * 0.015f);
+		driveCoeffs.driveSlow = 1.f / (driveTime * 1.1f);
+		driveCoeffs.driveFast = 1.f / ((driveTime - 0.99f * driveTime) * 1.1f);
+		driveCoeffs.dryAmt = 2.f - ratio;
+		driveCoeffs.wetAmt = ratio - 1.f;
 	}
 
-	inline float slide(const float &input, const float &prevOutput, const float &steps) {
-		//y (n) = y (n-1) + (x (n) - y (n-1))/steps
-		return prevOutput + (input - prevOutput) / steps;
+	//Soft knee, from the current coefficients
+	inline float calcAttenuation(float signalInDB) {
+		const float overshoot = threshold - signalInDB;
+
+		return 1.f + (1.f - jlimit(0.f, coeffs.knee, overshoot) * coeffs.invKnee) *
+			-(1.f - Decibels::decibelsToGain(overshoot * coeffs.slope));
 	}
 
-	inline float slide(const float &input, const float &prevOutput, const float &steps, const float &speedFactor)
-	{
-		//y (n) = y (n-1) + (x (n) - y (n-1))/steps
-		return prevOutput + (input - prevOutput) / (steps * speedFactor);
+	//y (n) = y (n-1) + (x (n) - y (n-1)) * coeff, coeff being 1 / steps
+	inline float slide(float input, float prevOutput, float coeff) {
+		return prevOutput + (input - prevOutput) * coeff;
 	}
 
 	constexpr static float driveTimeInMS = 1100.f;
 	constexpr static float compKnee = 1.0f;
-
-	double sampleRate;
-
-	float* channelData[chNum];
+	constexpr static double rampTimeInSeconds = 0.02;
+	constexpr static int controlInterval = 32; //engine samples between coefficient updates while ramping
+	constexpr static int paddedChannels = K_Simd::padToLanes(maxChNum);
+	constexpr static int detectorChunkSize = 256;
+	constexpr static float restTolerance = 1.0e-4f; //-80 dB, for isAtRest()
+
+	K_Simd::InstructionSet instructionSet;
+	const K_Simd::Kernels<SampleType>* kernels = nullptr;
+	const K_Simd::Kernels<float>* floatKernels = nullptr; //for gains worked out apart from the signal
+	K_Simd::CompressorCoeffs coeffs;
+	K_Simd::OverdriveCoeffs driveCoeffs;
+	const float* shaperTable = nullptr;
+	bool fastDetector = false;
+	K_LinkMode linkMode = K_LinkMode::off;
+	int numChannels = maxChNum,
+		lookahead = 0; //engine rate samples
+
+	K_Delay<SampleType> lookaheadDelay;
+	std::vector<K_WindowMax> windowMax; //one per channel, the first one when linked
+
+#if KWIRE_PROFILING
+	K_Profiler* profiler = nullptr;
+#endif
+
+	double sampleRate = 44100.0;
+
+	K_KwireParams params { 1.f, 0.f, 1.f, 1.f };
+	SmoothedValue<float, ValueSmoothingTypes::Linear> ratioRamp,
+		thresholdRamp;
+	bool coeffsDirty = false;
+	int samplesToControlStep = 0;
+
+	SampleType* channelData[(size_t)maxChNum];
+	const SampleType* detectorData[(size_t)maxChNum];
 
 	float ratio,
 		threshold,
@@ -150,11 +626,16 @@ private:
 		releaseInSamps,
 		driveTime;
 
-	float envelope[chNum],
-		prevEnvelope[chNum] = { 0.f },
-		rawAttenuation[chNum],
-		drive[chNum],
-		prevDrive[chNum] = { 0.f },
-		driveEnv[chNum],
-		prevDriveEnv[chNum] = { 0.f };
+	//one value per channel, padded and aligned so each group of lanes loads straight into a register
+	alignas(32) float prevEnvelope[(size_t)paddedChannels] = { 0.f },
+		prevDrive[(size_t)paddedChannels] = { 0.f },
+		prevDriveEnv[(size_t)paddedChannels] = { 0.f },
+		minGain[(size_t)paddedChannels],
+		detectorLevel[(size_t)maxChNum][(size_t)detectorChunkSize], //combined or lookahead detector level of the current chunk
+		detectorGain[(size_t)maxChNum][(size_t)detectorChunkSize]; //compressor gain of the current chunk, when it is worked out apart from the signal
+
+	float envelope[(size_t)maxChNum],
+		rawAttenuation[(size_t)maxChNum],
+		drive[(size_t)maxChNum],
+		driveEnv[(size_t)maxChNum];
 };
\ No newline at end of file
@@ -0,0 +1,500 @@
+//Generic K_Kwire kernels, written once against the Vec interface from K_Simd.h.
+//This file deliberately has no include guard: K_Kwire.cpp includes it once inside each instruction set's namespace,
+//after that namespace has defined its own Vec, so every set gets its own compiled copy.
+
+//=====
+//Math
+
+inline Vec::R floor(Vec::R v) {
+	auto t = Vec::truncate(v);
+	return Vec::select(Vec::gt(t, v), Vec::sub(t, Vec::set(1.f)), t);
+}
+
+//log2 for positive, normal inputs (Cephes logf polynomial, ~1 ulp)
+inline Vec::R log2(Vec::R v) {
+	auto e = Vec::exponent(v);
+	auto m = Vec::mantissa(v);
+
+	//move mantissa to [sqrt(0.5), sqrt(2))
+	auto big = Vec::gt(m, Vec::set(1.41421356f));
+	m = Vec::select(big, Vec::mul(m, Vec::set(0.5f)), m);
+	e = Vec::select(big, Vec::add(e, Vec::set(1.f)), e);
+
+	auto x = Vec::sub(m, Vec::set(1.f));
+	auto z = Vec::mul(x, x);
+
+	auto p = Vec::set(7.0376836292E-2f);
+	p = Vec::add(Vec::mul(p, x), Vec::set(-1.1514610310E-1f));
+	p = Vec::add(Vec::mul(p, x), Vec::set(1.1676998740E-1f));
+	p = Vec::add(Vec::mul(p, x), Vec::set(-1.2420140846E-1f));
+	p = Vec::add(Vec::mul(p, x), Vec::set(1.4249322787E-1f));
+	p = Vec::add(Vec::mul(p, x), Vec::set(-1.6668057665E-1f));
+	p = Vec::add(Vec::mul(p, x), Vec::set(2.0000714765E-1f));
+	p = Vec::add(Vec::mul(p, x), Vec::set(-2.4999993993E-1f));
+	p = Vec::add(Vec::mul(p, x), Vec::set(3.3333331174E-1f));
+
+	//ln(m) = x - z/2 + x*z*p
+	auto ln = Vec::add(Vec::sub(x, Vec::mul(z, Vec::set(0.5f))), Vec::mul(Vec::mul(x, z), p));
+
+	return Vec::add(Vec::mul(ln, Vec::set(1.44269504089f)), e);
+}
+
+//2^v, clamped to the normal float range (Cephes exp2f polynomial, ~2 ulp)
+inline Vec::R exp2(Vec::R v) {
+	v = Vec::min(Vec::max(v, Vec::set(-126.f)), Vec::set(126.f));
+
+	auto i = floor(Vec::add(v, Vec::set(0.5f)));
+	auto x = Vec::sub(v, i);
+
+	auto p = Vec::set(1.535336188319500E-4f);
+	p = Vec::add(Vec::mul(p, x), Vec::set(1.339887440266574E-3f));
+	p = Vec::add(Vec::mul(p, x), Vec::set(9.618437357674640E-3f));
+	p = Vec::add(Vec::mul(p, x), Vec::set(5.550332471162809E-2f));
+	p = Vec::add(Vec::mul(p, x), Vec::set(2.402264791363012E-1f));
+	p = Vec::add(Vec::mul(p, x), Vec::set(6.931472028550421E-1f));
+
+	return Vec::mul(Vec::add(Vec::mul(p, x), Vec::set(1.f)), Vec::pow2(i));
+}
+
+//Low order versions for the fast detector. Max error 2.1e-4 (log2) and 2.2e-4 relative (exp2), i.e. ~0.002 dB each.
+inline Vec::R fastLog2(Vec::R v) {
+	auto e = Vec::exponent(v);
+	auto m = Vec::mantissa(v);
+
+	auto big = Vec::gt(m, Vec::set(1.41421356f));
+	m = Vec::select(big, Vec::mul(m, Vec::set(0.5f)), m);
+	e = Vec::select(big, Vec::add(e, Vec::set(1.f)), e);
+
+	auto x = Vec::sub(m, Vec::set(1.f));
+
+	auto p = Vec::set(-0.335680975f);
+	p = Vec::add(Vec::mul(p, x), Vec::set(0.512732762f));
+	p = Vec::add(Vec::mul(p, x), Vec::set(-0.723645554f));
+	p = Vec::add(Vec::mul(p, x), Vec::set(1.44222604f));
+
+	return Vec::add(Vec::mul(p, x), e);
+}
+
+inline Vec::R fastExp2(Vec::R v) {
+	v = Vec::min(Vec::max(v, Vec::set(-126.f)), Vec::set(126.f));
+
+	auto i = floor(Vec::add(v, Vec::set(0.5f)));
+	auto x = Vec::sub(v, i);
+
+	auto p = Vec::set(0.0559219225f);
+	p = Vec::add(Vec::mul(p, x), Vec::set(0.242035815f));
+	p = Vec::add(Vec::mul(p, x), Vec::set(0.693126278f));
+
+	return Vec::mul(Vec::add(Vec::mul(p, x), Vec::set(1.f)), Vec::pow2(i));
+}
+
+//=====
+//Interleaving. Kernels run one register per sample, one lane per channel, over short chunks copied to the stack.
+//The lanes are always float. Double channels are converted on the way in and out, in the copies that happen anyway.
+
+constexpr int chunkSize = 64;
+
+template <typename Sample>
+inline void interleave(const Sample* const* channels, int firstChannel, int activeLanes, int start, int numSamples, float* lanes) {
+	for (int lane = 0; lane < activeLanes; ++lane) {
+		const Sample* source = channels[firstChannel + lane] + start;
+
+		for (int sample = 0; sample < numSamples; ++sample)
+			lanes[sample * Vec::width + lane] = (float)source[sample];
+	}
+}
+
+template <typename Sample>
+inline void deinterleave(const float* lanes, int firstChannel, int activeLanes, int start, int numSamples, Sample* const* channels) {
+	for (int lane = 0; lane < activeLanes; ++lane) {
+		Sample* dest = channels[firstChannel + lane] + start;
+
+		for (int sample = 0; sample < numSamples; ++sample)
+			dest[sample] = (Sample)lanes[sample * Vec::width + lane];
+	}
+}
+
+//Same as deinterleave, but multiplies the channels by the lanes instead of overwriting them
+template <typename Sample>
+inline void applyLanes(const float* lanes, int firstChannel, int activeLanes, int start, int numSamples, Sample* const* channels) {
+	for (int lane = 0; lane < activeLanes; ++lane) {
+		Sample* dest = channels[firstChannel + lane] + start;
+
+		for (int sample = 0; sample < numSamples; ++sample)
+			dest[sample] *= lanes[sample * Vec::width + lane];
+	}
+}
+
+//Same as deinterleave, but adds the lanes to the channels scaled by dryAmount
+template <typename Sample>
+inline void mixLanes(const float* lanes, int firstChannel, int activeLanes, int start, int numSamples, Sample* const* channels, float dryAmount) {
+	for (int lane = 0; lane < activeLanes; ++lane) {
+		Sample* dest = channels[firstChannel + lane] + start;
+
+		for (int sample = 0; sample < numSamples; ++sample)
+			dest[sample] = dest[sample] * dryAmount + lanes[sample * Vec::width + lane];
+	}
+}
+
+//=====
+//Compressor
+
+//Soft knee gain computer, same curve as K_Kwire::calcAttenuation
+inline Vec::R calcAttenuation(Vec::R input, const CompressorCoeffs& c) {
+	//Decibels::gainToDecibels
+	auto signalInDB = Vec::max(Vec::set(-100.f), Vec::mul(Vec::set(6.0205999f), log2(Vec::max(Vec::abs(input), Vec::set(1.0e-5f)))));
+
+	auto overshoot = Vec::sub(Vec::set(c.threshold), signalInDB);
+	auto knee = Vec::sub(Vec::set(1.f), Vec::mul(Vec::min(Vec::max(overshoot, Vec::set(0.f)), Vec::set(c.knee)), Vec::set(c.invKnee)));
+
+	//Decibels::decibelsToGain
+	auto gainInDB = Vec::mul(overshoot, Vec::set(c.slope));
+	auto gain = Vec::select(Vec::gt(gainInDB, Vec::set(-100.f)), exp2(Vec::mul(gainInDB, Vec::set(0.16609640474f))), Vec::set(0.f));
+
+	return Vec::sub(Vec::set(1.f), Vec::mul(knee, Vec::sub(Vec::set(1.f), gain)));
+}
+
+//Same curve worked out in the log2 domain with the low order approximations. Thresholds and knee are pre-scaled to log2 units,
+//so there is no dB conversion at all. Max error against calcAttenuation is 0.003 dB
+//(0.0025 dB measured over -110..+40 dB input across the ratio and threshold ranges).
+inline Vec::R calcAttenuationFast(Vec::R input, const CompressorCoeffs& c) {
+	//clamping at -100 dB keeps the level finite, as Decibels::gainToDecibels does
+	auto level = fastLog2(Vec::max(Vec::abs(input), Vec::set(1.0e-5f)));
+
+	auto overshoot = Vec::sub(Vec::set(c.thresholdLog2), level);
+	auto knee = Vec::sub(Vec::set(1.f), Vec::mul(Vec::min(Vec::max(overshoot, Vec::set(0.f)), Vec::set(c.kneeLog2)), Vec::set(c.invKneeLog2)));
+
+	auto gainLog2 = Vec::mul(overshoot, Vec::set(c.slope));
+	auto gain = Vec::select(Vec::gt(gainLog2, Vec::set(-16.6096405f)), fastExp2(gainLog2), Vec::set(0.f));
+
+	return Vec::sub(Vec::set(1.f), Vec::mul(knee, Vec::sub(Vec::set(1.f), gain)));
+}
+
+//prevEnvelope and minGain hold one value per channel, padded to a multiple of Vec::width and aligned.
+//minGain is lowered to the smallest envelope value seen, for the gain reduction meter.
+//keyed: the envelope follows detectors (e.g. a sidechain) instead of the channels it is applied to.
+template <bool fast, bool keyed, typename Sample>
+inline void compressLanes(Sample* const* channels, const Sample* const* detectors, int numChannels, int numSamples, float* prevEnvelope, float* minGain, const CompressorCoeffs& c) {
+	alignas(32) float lanes[chunkSize * Vec::width];
+
+	const auto attack = Vec::set(c.attack);
+	const auto release = Vec::set(c.release);
+
+	for (int firstChannel = 0; firstChannel < numChannels; firstChannel += Vec::width) {
+		const int activeLanes = jmin(Vec::width, numChannels - firstChannel);
+
+		//unused lanes stay silent
+		if (activeLanes < Vec::width)
+			std::fill(lanes, lanes + chunkSize * Vec::width, 0.f);
+
+		auto envelope = Vec::load(prevEnvelope + firstChannel);
+		auto lowest = Vec::load(minGain + firstChannel);
+
+		for (int start = 0; start < numSamples; start += chunkSize) {
+			const int count = jmin(chunkSize, numSamples - start);
+
+			interleave(detectors, firstChannel, activeLanes, start, count, lanes);
+
+			for (int sample = 0; sample < count; ++sample) {
+				float* frame = lanes + sample * Vec::width;
+				auto input = Vec::load(frame);
+
+				auto rawAttenuation = fast ? calcAttenuationFast(input, c) : calcAttenuation(input, c);
+
+				//envelope follower, release when the attenuation rises
+				auto coeff = Vec::select(Vec::gt(rawAttenuation, envelope), release, attack);
+				envelope = Vec::add(envelope, Vec::mul(Vec::sub(rawAttenuation, envelope), coeff));
+				lowest = Vec::min(lowest, envelope);
+
+				Vec::store(frame, keyed ? envelope : Vec::mul(input, envelope));
+			}
+
+			if (keyed)
+				applyLanes(lanes, firstChannel, activeLanes, start, count, channels);
+			else
+				deinterleave(lanes, firstChannel, activeLanes, start, count, channels);
+		}
+
+		Vec::store(prevEnvelope + firstChannel, envelope);
+		Vec::store(minGain + firstChannel, lowest);
+	}
+}
+
+//detectors may be the channels themselves, which saves a pass.
+//Double channels always take the keyed pass: only the envelope is float, the signal keeps its precision.
+template <typename Sample>
+inline void compress(Sample* const* channels, const Sample* const* detectors, int numChannels, int numSamples, float* prevEnvelope, float* minGain, const CompressorCoeffs& c, bool fast) {
+	const bool keyed = !std::is_same<Sample, float>::value || detectors != channels;
+
+	if (fast && keyed)
+		compressLanes<true, true>(channels, detectors, numChannels, numSamples, prevEnvelope, minGain, c);
+	else if (fast)
+		compressLanes<true, false>(channels, detectors, numChannels, numSamples, prevEnvelope, minGain, c);
+	else if (keyed)
+		compressLanes<false, true>(channels, detectors, numChannels, numSamples, prevEnvelope, minGain, c);
+	else
+		compressLanes<false, false>(channels, detectors, numChannels, numSamples, prevEnvelope, minGain, c);
+}
+
+//=====
+//Overdrive
+
+//Static part of the curve: three segment polynomial, as in K_Kwire::overdrive
+inline Vec::R clipCurve(Vec::R input) {
+	auto knee = Vec::mul(Vec::mul(Vec::set(0.9f), Vec::sub(input, Vec::set(0.1841f))), Vec::sub(Vec::set(2.2f), input));
+	auto upper = Vec::select(Vec::lt(input, Vec::set(1.192f)), Vec::select(Vec::gt(input, Vec::set(0.647f)), knee, Vec::set(0.f)), Vec::set(0.9144f));
+
+	return Vec::select(Vec::lt(input, Vec::set(0.647f)), input, upper);
+}
+
+//Drive independent sigmoid of the positive half, before the clip curve
+inline Vec::R staticSigmoid(Vec::R input) {
+	auto squared = Vec::mul(input, input);
+
+	return Vec::div(Vec::mul(input, Vec::add(Vec::set(27.f), Vec::mul(Vec::set(0.8f), squared))), Vec::add(Vec::set(27.f), Vec::mul(Vec::set(9.f), squared)));
+}
+
+//Everything after the drive dependent sigmoid on the positive half. This is what the shaper table stores.
+inline Vec::R positiveCurve(Vec::R input) {
+	return Vec::mul(clipCurve(Vec::mul(staticSigmoid(input), Vec::set(0.9f))), Vec::set(1.1111111f));
+}
+
+inline Vec::R lookupPositiveCurve(Vec::R input, const float* table) {
+	auto position = Vec::mul(Vec::min(Vec::max(input, Vec::set(0.f)), Vec::set(shaperTableRange)), Vec::set(shaperTableSize / shaperTableRange));
+	auto index = Vec::truncate(position);
+	auto fraction = Vec::sub(position, index);
+
+	auto y0 = Vec::lookup(table, index);
+	auto y1 = Vec::lookup(table + 1, index);
+
+	return Vec::add(y0, Vec::mul(fraction, Vec::sub(y1, y0)));
+}
+
+//Branch free version of K_Kwire::overdrive. Negative lanes leave the drive envelopes untouched and bypass the sigmoids.
+//Double channels keep the dry part of the mix in double, only the shaped part goes through the float lanes.
+template <bool useTable, typename Sample>
+inline void overdriveLanes(Sample* const* channels, int numChannels, int numSamples, float* prevDriveEnv, float* prevDrive, const OverdriveCoeffs& c, const float* table) {
+	alignas(32) float lanes[chunkSize * Vec::width];
+
+	const auto zero = Vec::set(0.f);
+	const auto one = Vec::set(1.f);
+
+	for (int firstChannel = 0; firstChannel < numChannels; firstChannel += Vec::width) {
+		const int activeLanes = jmin(Vec::width, numChannels - firstChannel);
+
+		if (activeLanes < Vec::width)
+			std::fill(lanes, lanes + chunkSize * Vec::width, 0.f);
+
+		auto driveEnv = Vec::load(prevDriveEnv + firstChannel);
+		auto drive = Vec::load(prevDrive + firstChannel);
+
+		for (int start = 0; start < numSamples; start += chunkSize) {
+			const int count = jmin(chunkSize, numSamples - start);
+
+			interleave(channels, firstChannel, activeLanes, start, count, lanes);
+
+			for (int sample = 0; sample < count; ++sample) {
+				float* frame = lanes + sample * Vec::width;
+				auto input = Vec::load(frame);
+
+				auto positive = Vec::ge(input, zero);
+				auto magnitude = Vec::abs(input);
+
+				//preliminary envelope, then the drive envelope which speeds up in clipping territory
+				driveEnv = Vec::select(positive, Vec::add(driveEnv, Vec::mul(Vec::sub(magnitude, driveEnv), Vec::set(c.driveEnv))), driveEnv);
+
+				auto coeff = Vec::select(Vec::lt(driveEnv, Vec::set(0.5f)), Vec::set(c.driveFast), Vec::set(c.driveSlow));
+				auto newDrive = Vec::add(drive, Vec::mul(Vec::sub(Vec::mul(magnitude, Vec::set(0.5f)), drive), coeff));
+				drive = Vec::select(positive, Vec::min(Vec::max(newDrive, zero), one), drive);
+
+				//logarithmic distribution
+				auto amount = Vec::mul(drive, Vec::sub(Vec::set(2.f), drive));
+
+				//drive dependent sigmoid
+				auto squared = Vec::mul(input, input);
+				auto shaped = Vec::div(
+					Vec::mul(input, Vec::add(Vec::set(27.f), Vec::mul(Vec::mul(Vec::sub(Vec::set(9.f), Vec::mul(Vec::set(8.2f), amount)), squared), Vec::set(0.8f)))),
+					Vec::add(Vec::set(27.f), Vec::mul(Vec::set(9.f), squared)));
+
+				Vec::R wet;
+
+				if (useTable) {
+					wet = Vec::select(positive, lookupPositiveCurve(shaped, table), Vec::sub(zero, clipCurve(magnitude)));
+				}
+				else {
+					//both halves share one pass through the clip curve
+					auto curveInput = Vec::select(positive, Vec::mul(staticSigmoid(shaped), Vec::set(0.9f)), magnitude);
+					auto scale = Vec::select(positive, Vec::set(1.1111111f), Vec::set(-1.f));
+					wet = Vec::mul(clipCurve(curveInput), scale);
+				}
+
+				//dry/wet mix controlled by ratio
+				if (std::is_same<Sample, float>::value)
+					Vec::store(frame, Vec::add(Vec::mul(input, Vec::set(c.dryAmt)), Vec::mul(wet, Vec::set(c.wetAmt))));
+				else
+					Vec::store(frame, Vec::mul(wet, Vec::set(c.wetAmt)));
+			}
+
+			if (std::is_same<Sample, float>::value)
+				deinterleave(lanes, firstChannel, activeLanes, start, count, channels);
+			else
+				mixLanes(lanes, firstChannel, activeLanes, start, count, channels, c.dryAmt);
+		}
+
+		Vec::store(prevDriveEnv + firstChannel, driveEnv);
+		Vec::store(prevDrive + firstChannel, drive);
+	}
+}
+
+template <typename Sample>
+inline void overdrive(Sample* const* channels, int numChannels, int numSamples, float* prevDriveEnv, float* prevDrive, const OverdriveCoeffs& c, const float* table) {
+	if (table != nullptr)
+		overdriveLanes<true>(channels, numChannels, numSamples, prevDriveEnv, prevDrive, c, table);
+	else
+		overdriveLanes<false>(channels, numChannels, numSamples, prevDriveEnv, prevDrive, c, table);
+}
+
+//=====
+//Linked detector. Like the output stage below, these run along the samples, one lane per sample.
+
+//Vec::width consecutive samples. Double samples are converted, the detector works in float.
+inline Vec::R loadSamples(const float* source) {
+	return Vec::loadUnaligned(source);
+}
+
+inline Vec::R loadSamples(const double* source) {
+	alignas(32) float converted[Vec::width];
+
+	for (int lane = 0; lane < Vec::width; ++lane)
+		converted[lane] = (float)source[lane];
+
+	return Vec::load(converted);
+}
+
+//Level of all channels together at each sample: the loudest channel, or the mean of their magnitudes
+template <typename Sample>
+inline void linkDetector(const Sample* const* channels, int numChannels, int numSamples, float* level, bool mean) {
+	const float scale = mean ? 1.f / (float)numChannels : 1.f;
+	int sample = 0;
+
+	for (; sample + Vec::width <= numSamples; sample += Vec::width) {
+		auto combined = Vec::abs(loadSamples(channels[0] + sample));
+
+		for (int channel = 1; channel < numChannels; ++channel) {
+			auto magnitude = Vec::abs(loadSamples(channels[channel] + sample));
+			combined = mean ? Vec::add(combined, magnitude) : Vec::max(combined, magnitude);
+		}
+
+		Vec::storeUnaligned(level + sample, Vec::mul(combined, Vec::set(scale)));
+	}
+
+	//leftover samples
+	for (; sample < numSamples; ++sample) {
+		float combined = std::abs((float)channels[0][sample]);
+
+		for (int channel = 1; channel < numChannels; ++channel)
+			combined = mean ? combined + std::abs((float)channels[channel][sample]) : jmax(combined, std::abs((float)channels[channel][sample]));
+
+		level[sample] = combined * scale;
+	}
+}
+
+//Multiplies every channel by the same gain curve
+inline void applyGain(float* const* channels, int numChannels, int numSamples, const float* gain) {
+	for (int channel = 0; channel < numChannels; ++channel) {
+		float* data = channels[channel];
+		int sample = 0;
+
+		for (; sample + Vec::width <= numSamples; sample += Vec::width)
+			Vec::storeUnaligned(data + sample, Vec::mul(Vec::loadUnaligned(data + sample), Vec::loadUnaligned(gain + sample)));
+
+		for (; sample < numSamples; ++sample)
+			data[sample] *= gain[sample];
+	}
+}
+
+//Double data stays double, the compiler is left to vectorize
+inline void applyGain(double* const* channels, int numChannels, int numSamples, const float* gain) {
+	for (int channel = 0; channel < numChannels; ++channel) {
+		double* data = channels[channel];
+
+		for (int sample = 0; sample < numSamples; ++sample)
+			data[sample] *= gain[sample];
+	}
+}
+
+//=====
+//Output stage. Unlike the channel-lane kernels above this one runs along a single channel, one lane per sample.
+
+//Dry/wet crossfade and output gain in one pass, both ramped linearly over the block:
+//out = (dry + (wet - dry) * mix) * gain
+//Also returns the sum of squares and peak of the incoming wet signal, for the meters.
+inline void mixAndGain(float* wet, const float* dry, int numSamples, const OutputCoeffs& c, float& wetSumOfSquares, float& wetPeak) {
+	alignas(32) float laneIndex[Vec::width];
+
+	for (int lane = 0; lane < Vec::width; ++lane)
+		laneIndex[lane] = (float)lane;
+
+	auto mix = Vec::add(Vec::set(c.mixStart), Vec::mul(Vec::load(laneIndex), Vec::set(c.mixStep)));
+	auto gain = Vec::add(Vec::set(c.gainStart), Vec::mul(Vec::load(laneIndex), Vec::set(c.gainStep)));
+	const auto mixAdvance = Vec::set(c.mixStep * Vec::width);
+	const auto gainAdvance = Vec::set(c.gainStep * Vec::width);
+
+	auto sumOfSquares = Vec::set(0.f);
+	auto peak = Vec::set(0.f);
+	int sample = 0;
+
+	for (; sample + Vec::width <= numSamples; sample += Vec::width) {
+		auto w = Vec::loadUnaligned(wet + sample);
+		auto d = Vec::loadUnaligned(dry + sample);
+
+		sumOfSquares = Vec::add(sumOfSquares, Vec::mul(w, w));
+		peak = Vec::max(peak, Vec::abs(w));
+
+		Vec::storeUnaligned(wet + sample, Vec::mul(Vec::add(d, Vec::mul(Vec::sub(w, d), mix)), gain));
+
+		mix = Vec::add(mix, mixAdvance);
+		gain = Vec::add(gain, gainAdvance);
+	}
+
+	alignas(32) float laneSums[Vec::width], lanePeaks[Vec::width];
+	Vec::store(laneSums, sumOfSquares);
+	Vec::store(lanePeaks, peak);
+
+	float sum = 0.f, maxPeak = 0.f;
+
+	for (int lane = 0; lane < Vec::width; ++lane) {
+		sum += laneSums[lane];
+		maxPeak = jmax(maxPeak, lanePeaks[lane]);
+	}
+
+	//leftover samples
+	for (; sample < numSamples; ++sample) {
+		const float w = wet[sample], d = dry[sample];
+
+		sum += w * w;
+		maxPeak = jmax(maxPeak, std::abs(w));
+
+		wet[sample] = (d + (w - d) * (c.mixStart + (float)sample * c.mixStep)) * (c.gainStart + (float)sample * c.gainStep);
+	}
+
+	wetSumOfSquares = sum;
+	wetPeak = maxPeak;
+}
+
+//Double version of the above, kept in double all the way and left to the compiler to vectorize
+inline void mixAndGain(double* wet, const double* dry, int numSamples, const OutputCoeffs& c, float& wetSumOfSquares, float& wetPeak) {
+	double sum = 0.0, maxPeak = 0.0;
+
+	for (int sample = 0; sample < numSamples; ++sample) {
+		const double w = wet[sample], d = dry[sample];
+
+		sum += w * w;
+		maxPeak = jmax(maxPeak, std::abs(w));
+
+		wet[sample] = (d + (w - d) * ((double)c.mixStart + (double)sample * c.mixStep)) * ((double)c.gainStart + (double)sample * c.gainStep);
+	}
+
+	wetSumOfSquares = (float)sum;
+	wetPeak = (float)maxPeak;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "K_Kwire.h"
+using namespace juce;
+
+//Frozen copy of the scalar compressor and overdrive, one channel and one sample at a time, with no ramps, kernels or
+//approximations. It is what K-wire sounds like: KwireBench --verify holds every optimized path of K_Kwire against it.
+//Don't change the math here to follow an optimization; only change it along with the sound, on purpose.
+template <int maxChNum>
+class K_KwireReference {
+public:
+	void setNumChannels(int newNumChannels) {
+		numChannels = jlimit(1, maxChNum, newNumChannels);
+		reset();
+	}
+
+	//Takes the new values at once, like K_Kwire::setupParams
+	void setParams(const K_KwireParams& params, double newSampleRate) {
+		sampleRate = newSampleRate;
+		ratio = params.ratio;
+		threshold = params.threshold;
+		attackInSamps = params.attack * sampleRate * 0.001;
+		releaseInSamps = params.release * sampleRate * 0.001;
+		driveTime = driveTimeInMS * sampleRate * 0.001;
+	}
+
+	void reset() {
+		std::fill(prevEnvelope, prevEnvelope + maxChNum, 0.f);
+		std::fill(prevDrive, prevDrive + maxChNum, 0.f);
+		std::fill(prevDriveEnv, prevDriveEnv + maxChNum, 0.f);
+	}
+
+	void compress(float* const* channels, int numSamples) {
+		const float slope = 1.f - (1.f / ((ratio - 1.0f) * 3.0f + 1.0f));
+
+		for (int channel = 0; channel < numChannels; ++channel) {
+			for (int sample = 0; sample < numSamples; ++sample) {
+				float& input = channels[channel][sample];
+
+				//attenuation calculation, soft knee
+				const float overshoot = threshold - Decibels::gainToDecibels(std::abs(input));
+				const float rawAttenuation = 1.f + (1.f - jlimit(0.f, compKnee, overshoot) / compKnee) *
+					-(1.f - Decibels::decibelsToGain(overshoot * slope));
+
+				//envelope follower
+				if (rawAttenuation > prevEnvelope[channel]) //release
+					prevEnvelope[channel] = slide(rawAttenuation, prevEnvelope[channel], releaseInSamps * 1.1f);
+				else //attack
+					prevEnvelope[channel] = slide(rawAttenuation, prevEnvelope[channel], attackInSamps * 1.1f);
+
+				input *= prevEnvelope[channel];
+			}
+		}
+	}
+
+	void overdrive(float* const* channels, int numSamples) {
+		const float dryAmt = 2.f - ratio,
+			wetAmt = ratio - 1.f; //amount of OD according to ratio
+
+		for (int channel = 0; channel < numChannels; ++channel) {
+			for (int sample = 0; sample < numSamples; ++sample) {
+				float& input = channels[channel][sample];
+				const float dry = input;
+
+				if (input >= 0.0) { //For positive signal values
+					//get preliminar envelope
+					prevDriveEnv[channel] = slide(std::abs(input), prevDriveEnv[channel], driveTime * 0.015f);
+
+					//is not in clipping territory
+					const bool clip = prevDriveEnv[channel] < 0.5f;
+
+					//get envelope
+					float drive = slide(std::abs(0.5f * input), prevDrive[channel], (clip ? driveTime - 0.99f * driveTime : driveTime) * 1.1f);
+					drive = jlimit(0.f, 1.f, drive);
+					prevDrive[channel] = drive;
+
+					drive = drive * (2.0f - drive); //logarithmic distribution
+
+					//Sigmoid
+					input = input * ((27.0f + ((9.0f - 8.2f * drive) * input * input * 0.8f)) / (27.0f + 9.0f * input * input));
+					input = input * ((27.0f + 0.8f * input * input) / (27.0f + 9.0f * input * input));
+
+					input = input * 0.9f;
+					input = input * (float)(input < 0.647f) + 0.9 * (input - 0.1841) * (2.2 - input) * (float)((input > 0.647f) && (input < 1.192f)) + 0.9144 * (float)(input >= 1.192f);
+					input = input * 1.1111111f;
+				}
+				else {
+					input = -input;
+
+					//Sigmoid
+					input = -1.f * (input * (float)(input < 0.647f) + 0.9 * (input - 0.1841) * (2.2 - input) * (float)((input > 0.647f) && (input < 1.192f)) + 0.9144 * (float)(input >= 1.192f));
+				}
+
+				input = dry * dryAmt + input * wetAmt;
+			}
+		}
+	}
+
+private:
+	//y (n) = y (n-1) + (x (n) - y (n-1)) / steps
+	static float slide(float input, float prevOutput, float steps) {
+		return prevOutput + (input - prevOutput) / steps;
+	}
+
+	constexpr static float driveTimeInMS = 1100.f;
+	constexpr static float compKnee = 1.0f;
+
+	int numChannels = maxChNum;
+	double sampleRate = 44100.0;
+
+	float ratio = 1.f,
+		threshold = 0.f,
+		attackInSamps = 1.f,
+		releaseInSamps = 1.f,
+		driveTime = 1.f;
+
+	float prevEnvelope[maxChNum] = { 0.f },
+		prevDrive[maxChNum] = { 0.f },
+		prevDriveEnv[maxChNum] = { 0.f };
+};
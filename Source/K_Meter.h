@@ -1,113 +1,89 @@
 #pragma once
 #include <JuceHeader.h>
-#include "PluginEditor.h"
+#include "K_MeterFifo.h"
 using namespace juce;
 
-template <int chNum>
-class K_Meter : public juce::AnimatedAppComponent
+//Level or gain reduction meter. Has no timer of its own: the owner pulls data and calls update() once per frame.
+//maxChNum matches the processor's meter blocks; setNumChannels() picks how many bars are drawn.
+template <int maxChNum>
+class K_Meter : public juce::Component
 {
 public:
     //Make meters with background
-    K_Meter(Colour metercolour, Colour bgmetercolour, int framerate, int interpolationSteps, bool peakOn) {
-        this->setOpaque(false);
-        setFramesPerSecond(framerate);
-        barColour = metercolour;
+    K_Meter(Colour metercolour, Colour bgmetercolour, int interpolationSteps, bool peakOn)
+        : K_Meter(metercolour, interpolationSteps, peakOn)
+    {
         backgroundOn = true;
         bgBarColour = bgmetercolour;
-        showPeakOn = peakOn;
-        interpSteps = interpolationSteps;
-
-        inData.resize(chNum, 0.f);
-        inPeakData.resize(chNum, 0.f);
-        dbValue.resize(chNum, -70.f);
-        peak.resize(chNum, -70.f);
-        rawValue.resize(chNum, 0.f);
-        maxRawValue.resize(chNum, 0.f);
-
-        std::vector<float> interpolationStepChannel; //Vector with channels
-
-        interpolationStepChannel.clear();
-        interpolationStepChannel.resize(interpSteps, 0.f);
-        interpolationStep.clear();
-        interpolationStep.resize(chNum, interpolationStepChannel);
     }
 
     //Make meters with no background
-    K_Meter(Colour metercolour, int framerate, int interpolationSteps, bool peakOn)
+    K_Meter(Colour metercolour, int interpolationSteps, bool peakOn)
     {
         this->setOpaque(false);
-        setFramesPerSecond(framerate);
         barColour = metercolour; //save colour
-        backgroundOn = false;
         showPeakOn = peakOn;
-        interpSteps = interpolationSteps;
-
-        inData.resize(chNum, 0.f);
-        inPeakData.resize(chNum, 0.f);
-        dbValue.resize(chNum, -70.f);
-        peak.resize(chNum, -70.f);
-        rawValue.resize(chNum, 0.f);
-        maxRawValue.resize(chNum, 0.f);
+        interpSteps = jlimit(1, maxInterpSteps, interpolationSteps);
 
-        std::vector<float> interpolationStepChannel;
-
-        interpolationStepChannel.clear();
-        interpolationStepChannel.resize(interpSteps, 0.f);
-        interpolationStep.clear();
-        interpolationStep.resize(chNum, interpolationStepChannel);
+        std::fill(dbValue, dbValue + maxChNum, minDb);
+        std::fill(peak, peak + maxChNum, minDb);
+        clearHistory(0.f);
     }
 
-    //Use this in timerCallback() to pull amplitude data from the processor
-    inline void getData(const std::vector<juce::Atomic<float>> &rmsData)
+    //Use this once per frame to pull amplitude data from the processor.
+    //Takes every block queued since the last call, so no peak is missed whatever the host's block size.
+    inline void getData(K_MeterFifo<K_MeterBlock<maxChNum>> &levels)
     {
-       for (int i = 0; i < chNum; i++)
+        K_MeterBlock<maxChNum> summary;
+
+        //nothing processed since the last frame, hold the previous reading
+        if (!levels.pull(summary))
+            return;
+
+        for (int i = 0; i < numChannels; i++)
         {
-            inData[i] = abs(rmsData[i].get());
-            inData[i] = inData[i] > 1.f ? 1.f : inData[i];
+            inData[i] = jmin(1.f, summary.getRMS(i));
+            inPeakData[i] = jmin(1.f, summary.peak[i]);
         }
     }
 
-    //Use this in timerCallback() to pull amplitude data from the processor
-    inline void getData(const std::vector<juce::Atomic<float>> &rmsData, const std::vector<juce::Atomic<float>> &peakLevelData)
+    //Use this once per frame to pull the compressor's gain from the processor. Call setGainReduction() first.
+    inline void getData(K_MeterFifo<K_GainReductionBlock<maxChNum>> &reduction)
     {
-        for (int i = 0; i < chNum; i++)
-        {
-            inData[i] = abs(rmsData[i].get());
-            inData[i] = inData[i] > 1.f ? 1.f : inData[i];
+        K_GainReductionBlock<maxChNum> summary;
 
-            inPeakData[i] = abs(peakLevelData[i].get());
-            inPeakData[i] = inPeakData[i] > 1.f ? 1.f : inPeakData[i];
-        }
+        if (!reduction.pull(summary))
+            return;
+
+        for (int i = 0; i < numChannels; i++)
+            inData[i] = jlimit(0.f, 1.f, summary.minGain[i]);
     }
 
-    //Calculate peak value
-    void getPeak() {
-        //peak value calculation and logic
-        if (!isMouseOverOrDragging())
-        {
-            //show peak normally
-            for (int i = 0; i < chNum; i++)
-            {
-                if (20.0f * log10(inPeakData[i]) > peak[i])
-                    peak[i] = 20 * log10(inPeakData[i]);
-            }
-        }
-        else
-        {
-            //reset the peak
-            for (int i = 0; i < chNum; i++)
-                peak[i] = 20 * log10(inPeakData[i]);
-        }
+    //Number of bars, 1 to maxChNum. Follow the processor's bus layout with this.
+    void setNumChannels(int newNumChannels) {
+        newNumChannels = jlimit(1, maxChNum, newNumChannels);
 
-        //Show peak value
-        //peakStr = std::to_string(peak); 
-        //peakStr = peakStr.dropLastCharacters(4);
+        if (newNumChannels == numChannels)
+            return;
+
+        numChannels = newNumChannels;
+        resized();
+    }
+
+    //Show gain reduction instead of level: the bar hangs from the top, full length at rangeInDb of reduction
+    void setGainReduction(float rangeInDb) {
+        reductionRange = rangeInDb;
+        showPeakOn = false;
+
+        std::fill(dbValue, dbValue + maxChNum, 0.f);
+        std::fill(inData, inData + maxChNum, 1.f);
+        clearHistory(1.f);
     }
 
     //Paint the meters
     void paint(Graphics& g) override {
 
-        for (int i = 0; i < chNum; i++)
+        for (int i = 0; i < numChannels; i++)
         {
             if (backgroundOn)
             {
@@ -131,86 +107,103 @@ public:
 
     }
 
-    //Update
-    void update() override {
-        for (int i = 0; i < chNum; i++)
-        {
-            //=====
-            //Interpolate the last (interpSteps) values for smooth meter movement.
+    //Static geometry only changes with the size
+    void resized() override {
+        meterHeight = this->getHeight() * 0.89f; //Meter height within component
+        meterYstart = this->getHeight() * 0.1f; //Meter Y start position within component
 
-            //Replace interpolation buffer step n with n+1, n+2..
-            interpolationStep[i].erase(interpolationStep[i].begin());
+        textSpace = Rectangle<float>(0.05f * this->getWidth(), 0, 0.9f * this->getWidth(), 0.08f * this->getHeight());
 
-            //Push incoming data to LAST spot in the array
-            interpolationStep[i].push_back(inData[i]);
+        //Set rectangle for meter BG
+        for (int i = 0; i < numChannels; i++)
+        {
+            BGbarSpace[i] = Rectangle<float>(meterXpos(i), meterYstart, meterWidth(), meterHeight);
+            barSpace[i] = barRectangle(i);
+            peakSpace[i] = peakRectangle(i);
+        }
 
-            //Reset rawValue for calculation of new buffer
-            rawValue[i] = 0.f;
+        repaint();
+    }
 
-            //Sum interpolation steps and make value
-            //sum the values in the arrays
-            rawValue[i] = std::accumulate(interpolationStep[i].begin(), interpolationStep[i].end(), 0.f);
+    //Advance the ballistics by one 60 Hz frame and repaint what moved by at least a pixel.
+    //Returns false once the meter has come to rest.
+    bool update() {
+        bool moved = false;
 
-            rawValue[i] /= interpSteps; //normalise
-            rawValue[i] = jlimit(0.f, 1.f, rawValue[i]); //clip
-            rawValue[i] = 20 * log10(rawValue[i]);
+        for (int i = 0; i < numChannels; i++)
+        {
+            //=====
+            //Interpolate the last (interpSteps) values for smooth meter movement.
+            //Ring buffer with a running sum: swap the oldest value for the newest.
+            historySum[i] += inData[i] - history[i][historyPos];
+            history[i][historyPos] = inData[i];
 
-            //calculate dbValue if the new value is larger
-            if (rawValue[i] >= maxRawValue[i])
-            {
-                dbValue[i] = rawValue[i];
+            float rawValue = historySum[i] / interpSteps; //normalise
+            rawValue = jlimit(0.f, 1.f, rawValue); //clip
+            rawValue = 20 * log10(rawValue);
 
-                maxRawValue[i] = rawValue[i];
+            //Gain reduction: jumps to more reduction, recovers at the linear shrink rate
+            if (reductionRange > 0.f)
+            {
+                dbValue[i] = jlimit(0.f, reductionRange, jmax(-rawValue, dbValue[i] - linearShrinkRate));
             }
-            //Shrink meter size if new value isn't larger
             else
             {
-                dbValue[i] -= linearShrinkRate + exponentialShrinkRate * Decibels::decibelsToGain(dbValue[i]);
-                maxRawValue[i] -= linearShrinkRate + exponentialShrinkRate * Decibels::decibelsToGain(maxRawValue[i]);
+                //calculate dbValue if the new value is larger
+                if (rawValue >= maxRawValue[i])
+                {
+                    dbValue[i] = rawValue;
+
+                    maxRawValue[i] = rawValue;
+                }
+                //Shrink meter size if new value isn't larger
+                else
+                {
+                    dbValue[i] -= linearShrinkRate + exponentialShrinkRate * Decibels::decibelsToGain(dbValue[i]);
+                    maxRawValue[i] -= linearShrinkRate + exponentialShrinkRate * Decibels::decibelsToGain(maxRawValue[i]);
+                }
+
+                //Clip between 0.0 db and minDb
+                dbValue[i] = jlimit(minDb, 0.f, dbValue[i]);
             }
 
-            //Clip between 0.0 db and minDb
-            dbValue[i] = jlimit(minDb, 0.f, dbValue[i]);
-
-
-            //Calculate meter position / upper limit
-            auto size = 1 - (dbValue[i] / minDb);
-            //Exponential
-            size = size * size;
-
-            //Calculate rectangles for meters.
-            //Is not static because component might be resized (also doesn't work in the constructor because component size hasn't been set at that point).
-            float meterHeight = this->getHeight() * 0.89f; //Meter height within component
-            float meterYstart = this->getHeight() * 0.1f; //Meter Y start position within component
-
-            float barHeight = meterHeight * size;
-            float barY = (float)this->getHeight() * 0.1f + meterHeight * (1.f - size);
+            auto bar = barRectangle(i);
 
-            textSpace = Rectangle<float>::Rectangle(0.05f * this->getWidth(), 0, 0.9f * this->getWidth(), 0.08f * this->getHeight());
-
-            //Set rectangle for meter BG
-            for (int i = 0; i < chNum; i++)
-                BGbarSpace[i] = Rectangle<float>::Rectangle(meterXpos(i), meterYstart, meterWidth(), meterHeight);
-
-            //Set rectangle for meter
-            barSpace[i] = Rectangle<float>::Rectangle(meterXpos(i), barY, meterWidth(), barHeight);
+            if (bar.getSmallestIntegerContainer() != barSpace[i].getSmallestIntegerContainer())
+            {
+                repaintChange(barSpace[i], bar);
+                barSpace[i] = bar;
+                moved = true;
+            }
 
             if (showPeakOn)
             {
-                //Calculate peak value
-                getPeak();
+                //peak value calculation and logic. Hovering resets the peak.
+                auto peakDb = 20 * log10(inPeakData[i]);
 
-                //Calculate position along Y. Limit to avoid signals below minDb making negative peakPos values.
-                auto peakPos = jlimit(0.f, 1.f, 1 - peak[i] / minDb);
-                //Exponential
-                peakPos = peakPos * peakPos;
+                if (peakDb > peak[i] || isMouseOverOrDragging())
+                    peak[i] = peakDb;
 
-                auto peakY = (float)this->getHeight() * 0.1f + meterHeight * (1 - peakPos);
+                auto peakBar = peakRectangle(i);
 
-                //Set rectangle for peak
-                peakSpace[i] = Rectangle<float>::Rectangle(meterXpos(i), peakY, meterWidth(), peakBarThickness);
+                if (peakBar.getSmallestIntegerContainer() != peakSpace[i].getSmallestIntegerContainer())
+                {
+                    repaint(peakSpace[i].getSmallestIntegerContainer());
+                    repaint(peakBar.getSmallestIntegerContainer());
+                    peakSpace[i] = peakBar;
+                    moved = true;
+                }
             }
         }
+
+        historyPos = (historyPos + 1) % interpSteps;
+
+        //Re-add the window once per lap, so rounding in the running sums can't build up
+        if (historyPos == 0)
+            for (int i = 0; i < numChannels; i++)
+                historySum[i] = std::accumulate(history[i], history[i] + interpSteps, 0.f);
+
+        return moved;
     }
 
 private:
@@ -219,62 +212,116 @@ private:
         minDb = -70.f, //lowest db value to display; bottom of the rectangle.
         peakBarThickness = 3.f;
 
+    constexpr static int maxInterpSteps = 32;
+
     bool backgroundOn = false, //background colour display toggle
         showPeakOn; //peak level marker display toggle
 
     Colour barColour, //meter colours
         bgBarColour;
 
-    int interpSteps; //number of meter interpolation steps / ballistics smoothness
-        //channels;  //number of channels
+    float reductionRange = 0.f; //dB of gain reduction at full length, 0 for a level meter
 
-    std::vector<float> inData, //Absolute value of incoming RMS amplitude
-        inPeakData, //Absolute value of incoming peak amplitude
-        dbValue, //Meter value in dB
-        peak, //Peak value in dB
-        rawValue, //meter data in amplitude
-        maxRawValue; //Used to compare to next value
+    int interpSteps, //number of meter interpolation steps / ballistics smoothness
+        historyPos = 0, //ring buffer write position, shared by all channels
+        numChannels = maxChNum; //bars drawn
+
+    float inData[maxChNum] = { 0.f }, //Absolute value of incoming RMS amplitude
+        inPeakData[maxChNum] = { 0.f }, //Absolute value of incoming peak amplitude
+        dbValue[maxChNum], //Meter value in dB
+        peak[maxChNum], //Peak value in dB
+        maxRawValue[maxChNum] = { 0.f }, //Used to compare to next value
+        history[maxChNum][maxInterpSteps], //last interpSteps values of inData
+        historySum[maxChNum];
+
+    float meterHeight = 0.f,
+        meterYstart = 0.f;
 
     //space for elements
-    Rectangle<float> BGbarSpace[chNum],
-        barSpace[chNum],
-        peakSpace[chNum],
+    Rectangle<float> BGbarSpace[maxChNum],
+        barSpace[maxChNum],
+        peakSpace[maxChNum],
         textSpace;
 
     //Peak value text
     String peakStr;
 
-    std::vector<std::vector<float>> interpolationStep;
-    //dsp::AudioBlock<float> inBlock[chNum];
-
     ///Methods
+    void clearHistory(float value) {
+        for (int i = 0; i < maxChNum; i++)
+        {
+            std::fill(history[i], history[i] + maxInterpSteps, value);
+            historySum[i] = value * interpSteps;
+        }
+    }
+
+    //Meter rectangle for the current dbValue
+    Rectangle<float> barRectangle(int channel) {
+        if (reductionRange > 0.f)
+            return Rectangle<float>(meterXpos(channel), meterYstart, meterWidth(), meterHeight * dbValue[channel] / reductionRange);
+
+        //Calculate meter position / upper limit
+        auto size = 1 - (dbValue[channel] / minDb);
+        //Exponential
+        size = size * size;
+
+        return Rectangle<float>(meterXpos(channel), meterYstart + meterHeight * (1.f - size), meterWidth(), meterHeight * size);
+    }
+
+    //Peak marker rectangle for the current peak
+    Rectangle<float> peakRectangle(int channel) {
+        //Calculate position along Y. Limit to avoid signals below minDb making negative peakPos values.
+        auto peakPos = jlimit(0.f, 1.f, 1 - peak[channel] / minDb);
+        //Exponential
+        peakPos = peakPos * peakPos;
+
+        return Rectangle<float>(meterXpos(channel), meterYstart + meterHeight * (1 - peakPos), meterWidth(), peakBarThickness);
+    }
+
+    //Bars keep one end fixed, so only the strip between the old and new free ends needs painting
+    void repaintChange(const Rectangle<float>& before, const Rectangle<float>& after) {
+        if (before == after)
+            return;
+
+        Rectangle<float> changed;
+
+        if (before.getY() == after.getY())
+            changed = Rectangle<float>::leftTopRightBottom(after.getX(), jmin(before.getBottom(), after.getBottom()), after.getRight(), jmax(before.getBottom(), after.getBottom()));
+        else if (before.getBottom() == after.getBottom())
+            changed = Rectangle<float>::leftTopRightBottom(after.getX(), jmin(before.getY(), after.getY()), after.getRight(), jmax(before.getY(), after.getY()));
+        else
+            changed = before.getUnion(after);
+
+        repaint(changed.getSmallestIntegerContainer());
+    }
+
     //Returns the meters' width within the component rectangle
     float meterWidth() {
         float width;
 
-        if (chNum == 1)
-            width = 1.f;
+        if (numChannels == 1)
+            width = (float)this->getWidth();
         else
-            width = (float)this->getWidth() * (0.8f / chNum);
+            width = (float)this->getWidth() * (0.8f / numChannels);
 
         return width;
     }
 
-    //Returns the x position of a meter within the component rectangle for the specified channel 
+    //Returns the x position of a meter within the component rectangle for the specified channel
     float meterXpos(const int &channel) {
         float meterWidth, meterGap;
 
-        if (chNum == 1) {
-            meterWidth = 1.f;
+        if (numChannels == 1) {
+            meterWidth = (float)this->getWidth();
             meterGap = 0.f;
         }
         else {
-            meterWidth = (float)this->getWidth() * (0.8f / chNum);
-            meterGap = (float)this->getWidth() * 0.2f / (chNum - 1);
+            meterWidth = (float)this->getWidth() * (0.8f / numChannels);
+            meterGap = (float)this->getWidth() * 0.2f / (numChannels - 1);
         }
 
         float x = channel * (meterWidth + meterGap);
 
         return x;
     }
-};
\ No newline at end of file
+};
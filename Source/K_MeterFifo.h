@@ -0,0 +1,92 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <array>
+using namespace juce;
+
+//Levels of one block at one metering point. RMS is sqrt(sumOfSquares / numSamples).
+template <int chNum>
+struct K_MeterBlock {
+	float sumOfSquares[chNum] = { 0.f },
+		peak[chNum] = { 0.f };
+
+	int numSamples = 0;
+
+	//Folds another block into this one
+	void merge(const K_MeterBlock& other) {
+		for (int channel = 0; channel < chNum; ++channel) {
+			sumOfSquares[channel] += other.sumOfSquares[channel];
+			peak[channel] = jmax(peak[channel], other.peak[channel]);
+		}
+
+		numSamples += other.numSamples;
+	}
+
+	float getRMS(int channel) const {
+		return numSamples > 0 ? std::sqrt(sumOfSquares[channel] / (float)numSamples) : 0.f;
+	}
+};
+
+//Lowest compressor gain of one block, for the gain reduction meter
+template <int chNum>
+struct K_GainReductionBlock {
+	float minGain[chNum];
+	int numSamples = 0;
+
+	K_GainReductionBlock() {
+		std::fill(minGain, minGain + chNum, 1.f);
+	}
+
+	void merge(const K_GainReductionBlock& other) {
+		for (int channel = 0; channel < chNum; ++channel)
+			minGain[channel] = jmin(minGain[channel], other.minGain[channel]);
+
+		numSamples += other.numSamples;
+	}
+};
+
+//Single producer (audio thread), single consumer (message thread) queue of per-block meter data,
+//K_MeterBlock or K_GainReductionBlock. Nothing is dropped: if the queue is full, blocks are merged until there is room again.
+template <typename Block>
+class K_MeterFifo {
+public:
+	//Audio thread
+	void push(const Block& block) {
+		pending.merge(block);
+
+		//nobody is reading, so start over instead of averaging over minutes of audio
+		if (pending.numSamples > maxPendingSamples)
+			pending = block;
+
+		const auto scope = fifo.write(1);
+
+		if (scope.blockSize1 > 0) {
+			blocks[(size_t)scope.startIndex1] = pending;
+			pending = {};
+		}
+	}
+
+	//Message thread. Combines everything queued since the last call. Returns false if there was nothing new.
+	bool pull(Block& summary) {
+		summary = {};
+
+		const auto scope = fifo.read(fifo.getNumReady());
+
+		for (int i = 0; i < scope.blockSize1; ++i)
+			summary.merge(blocks[(size_t)(scope.startIndex1 + i)]);
+
+		for (int i = 0; i < scope.blockSize2; ++i)
+			summary.merge(blocks[(size_t)(scope.startIndex2 + i)]);
+
+		return summary.numSamples > 0;
+	}
+
+private:
+	//enough for a 60 Hz reader with 32 sample blocks at 192 kHz, several times over
+	constexpr static int capacity = 512;
+	constexpr static int maxPendingSamples = 1 << 16;
+
+	AbstractFifo fifo { capacity };
+	std::array<Block, capacity> blocks;
+
+	Block pending; //audio thread only
+};
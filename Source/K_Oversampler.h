@@ -0,0 +1,503 @@
+#pragma once
+#include <juce_dsp/juce_dsp.h>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+using namespace juce;
+
+//The filter of one 2x half-band stage, the same one up and down. Immutable once designed.
+template <typename SampleType>
+struct K_HalfBandDesign {
+	using FilterType = typename dsp::Oversampling<SampleType>::FilterType;
+
+	FilterType type = FilterType::filterHalfBandFIREquiripple;
+
+	//FIR: the taps. IIR: one coefficient per allpass section, the direct path's first.
+	std::vector<SampleType> coefficients;
+
+	//Up and down together, in samples at the stage's oversampled rate
+	SampleType latency = 0;
+};
+
+//Process-wide cache of half-band designs, keyed by the filter type, transition width and stopband attenuation. Designing is most of the cost of building an oversampler, so every instance, and every re-prepare
+//for a new rate or block size, shares the one design and its coefficients. The cache only holds weak references: a
+//design lives as long as some oversampler uses it.
+template <typename SampleType>
+class K_FilterDesignCache {
+public:
+	using Design = K_HalfBandDesign<SampleType>;
+	using FilterType = typename Design::FilterType;
+
+	//Any thread but the audio thread. The first caller designs, concurrent callers with the same settings wait for it.
+	static std::shared_ptr<const Design> get(FilterType type, float transitionWidth, float attenuation) {
+		auto& cache = getInstance();
+		const Key key { (int)type, transitionWidth, attenuation };
+
+		const ScopedLock sl(cache.lock);
+		auto& entry = cache.designs[key];
+
+		if (auto design = entry.lock())
+			return design;
+
+		auto design = std::make_shared<const Design>(makeDesign(type, (SampleType)transitionWidth, (SampleType)attenuation));
+		entry = design;
+		return design;
+	}
+
+private:
+	using Key = std::tuple<int, float, float>;
+	using Structure = typename dsp::FilterDesign<SampleType>::IIRPolyphaseAllpassStructure;
+
+	CriticalSection lock;
+	std::map<Key, std::weak_ptr<const Design>> designs;
+
+	static K_FilterDesignCache& getInstance() {
+		static K_FilterDesignCache cache;
+		return cache;
+	}
+
+	//The same designs, and the same latency, as juce::dsp::Oversampling's own stages
+	static Design makeDesign(FilterType type, SampleType transitionWidth, SampleType attenuation) {
+		Design design;
+		design.type = type;
+
+		if (type == FilterType::filterHalfBandPolyphaseIIR) {
+			auto structure = dsp::FilterDesign<SampleType>::designIIRLowpassHalfBandPolyphaseAllpassMethod(transitionWidth, attenuation);
+			design.coefficients = getAllpassCoefficients(structure);
+			design.latency = 2 * getPhaseDelay(structure);
+		}
+		else {
+			auto fir = dsp::FilterDesign<SampleType>::designFIRLowpassHalfBandEquirippleMethod(transitionWidth, attenuation);
+			design.coefficients.assign(fir->coefficients.begin(), fir->coefficients.end());
+			design.latency = static_cast<SampleType>(design.coefficients.size() - 1);
+		}
+
+		return design;
+	}
+
+	//Every section is a first order allpass in z^2 with one coefficient. The delayed path starts with its unit delay,
+	//which the oversampler does itself.
+	static std::vector<SampleType> getAllpassCoefficients(const Structure& structure) {
+		std::vector<SampleType> coefficients;
+
+		for (int i = 0; i < structure.directPath.size(); ++i)
+			coefficients.push_back(structure.directPath[i]->coefficients[0]);
+
+		for (int i = 1; i < structure.delayedPath.size(); ++i)
+			coefficients.push_back(structure.delayedPath[i]->coefficients[0]);
+
+		return coefficients;
+	}
+
+	//Low frequency phase delay of the whole filter, worked out from its transfer function
+	static SampleType getPhaseDelay(const Structure& structure) {
+		constexpr auto one = static_cast<SampleType>(1.0);
+		dsp::Polynomial<SampleType> numeratorDirect({ one }), denominatorDirect({ one }), numeratorDelayed({ one }), denominatorDelayed({ one });
+
+		auto multiply = [one](const auto& path, dsp::Polynomial<SampleType>& numerator, dsp::Polynomial<SampleType>& denominator) {
+			for (int i = 0; i < path.size(); ++i) {
+				const auto& c = path[i]->coefficients;
+
+				if (path[i]->getFilterOrder() == 1) {
+					numerator = numerator.getProductWith(dsp::Polynomial<SampleType>({ c[0], c[1] }));
+					denominator = denominator.getProductWith(dsp::Polynomial<SampleType>({ one, c[2] }));
+				}
+				else {
+					numerator = numerator.getProductWith(dsp::Polynomial<SampleType>({ c[0], c[1], c[2] }));
+					denominator = denominator.getProductWith(dsp::Polynomial<SampleType>({ one, c[3], c[4] }));
+				}
+			}
+		};
+
+		multiply(structure.directPath, numeratorDirect, denominatorDirect);
+		multiply(structure.delayedPath, numeratorDelayed, denominatorDelayed);
+
+		auto numerator = numeratorDirect.getProductWith(denominatorDelayed).getSumWith(numeratorDelayed.getProductWith(denominatorDirect));
+		auto denominator = denominatorDirect.getProductWith(denominatorDelayed);
+
+		dsp::IIR::Coefficients<SampleType> filter;
+		filter.coefficients.clear();
+		auto inversion = one / denominator[0];
+
+		for (int i = 0; i <= numerator.getOrder(); ++i)
+			filter.coefficients.add(numerator[i] * inversion);
+
+		for (int i = 1; i <= denominator.getOrder(); ++i)
+			filter.coefficients.add(denominator[i] * inversion);
+
+		constexpr double frequency = 0.0001;
+		return static_cast<SampleType>(-filter.getPhaseForFrequency(frequency, 1.0) / (frequency * MathConstants<double>::twoPi));
+	}
+};
+
+//The part of juce::dsp::Oversampling the plugin uses: half-band stages with the same filter up and down, and the latency
+//padded to whole samples. Same filters, processing and latency, except that the stages take their coefficients from
+//K_FilterDesignCache rather than each designing its own copy. Only the buffers and the per-channel filter state belong
+//to the oversampler, so building one is cheap once its design exists. KwireBench --verify checks it against JUCE's.
+template <typename SampleType>
+class K_Oversampler {
+public:
+	using FilterType = typename K_HalfBandDesign<SampleType>::FilterType;
+
+	explicit K_Oversampler(size_t numberOfChannels) : numChannels(numberOfChannels) {
+	}
+
+	//A stage that only copies, for 1x
+	void addDummyOversamplingStage() {
+		stages.emplace_back(nullptr, numChannels);
+	}
+
+	void addOversamplingStage(FilterType type, float transitionWidth, float attenuation) {
+		stages.emplace_back(K_FilterDesignCache<SampleType>::get(type, transitionWidth, attenuation), numChannels);
+		factorOversampling *= 2;
+	}
+
+	//Sizes the buffers for blocks of up to maximumNumberOfSamplesBeforeOversampling, and resets
+	void initProcessing(size_t maximumNumberOfSamplesBeforeOversampling) {
+		jassert(!stages.empty());
+		auto currentNumSamples = maximumNumberOfSamplesBeforeOversampling;
+
+		for (auto& stage : stages) {
+			currentNumSamples *= stage.factor;
+			stage.buffer.setSize((int)numChannels, (int)currentNumSamples, false, false, true);
+		}
+
+		delay.prepare({ 0.0, (uint32)maximumNumberOfSamplesBeforeOversampling, (uint32)numChannels });
+		updateDelayLine();
+
+		reset();
+	}
+
+	void reset() noexcept {
+		jassert(!stages.empty());
+
+		for (auto& stage : stages)
+			stage.reset();
+
+		delay.reset();
+	}
+
+	//Returns the oversampled block, which is the oversampler's own buffer
+	dsp::AudioBlock<SampleType> processSamplesUp(const dsp::AudioBlock<const SampleType>& inputBlock) noexcept {
+		jassert(!stages.empty());
+
+		stages.front().processSamplesUp(inputBlock);
+		auto block = stages.front().getProcessedSamples(inputBlock.getNumSamples() * stages.front().factor);
+
+		for (size_t i = 1; i < stages.size(); ++i) {
+			stages[i].processSamplesUp(block);
+			block = stages[i].getProcessedSamples(block.getNumSamples() * stages[i].factor);
+		}
+
+		return block;
+	}
+
+	//Downsamples what processSamplesUp returned into outputBlock
+	void processSamplesDown(dsp::AudioBlock<SampleType>& outputBlock) noexcept {
+		jassert(!stages.empty());
+
+		auto currentNumSamples = outputBlock.getNumSamples();
+
+		for (size_t n = 0; n + 1 < stages.size(); ++n)
+			currentNumSamples *= stages[n].factor;
+
+		for (size_t n = stages.size() - 1; n > 0; --n) {
+			auto block = stages[n - 1].getProcessedSamples(currentNumSamples);
+			stages[n].processSamplesDown(block);
+			currentNumSamples /= stages[n].factor;
+		}
+
+		stages.front().processSamplesDown(outputBlock);
+
+		if (fractionalDelay > static_cast<SampleType>(0.0)) {
+			auto context = dsp::ProcessContextReplacing<SampleType>(outputBlock);
+			delay.process(context);
+		}
+	}
+
+	//In whole samples at the input rate
+	SampleType getLatencyInSamples() const noexcept {
+		return std::round(getUncompensatedLatency() + fractionalDelay);
+	}
+
+	size_t getOversamplingFactor() const noexcept { return factorOversampling; }
+
+	const size_t numChannels;
+
+private:
+	struct Stage {
+		Stage(std::shared_ptr<const K_HalfBandDesign<SampleType>> stageDesign, size_t numberOfChannels)
+			: design(std::move(stageDesign)), factor(design != nullptr ? 2 : 1) {
+			if (design == nullptr)
+				return;
+
+			if (design->type == FilterType::filterHalfBandPolyphaseIIR) {
+				stateUp.setSize((int)numberOfChannels, (int)design->coefficients.size());
+				stateDown.setSize((int)numberOfChannels, (int)design->coefficients.size());
+				delayDown.resize(numberOfChannels);
+			}
+			else {
+				const auto numTaps = design->coefficients.size();
+
+				stateUp.setSize((int)numberOfChannels, (int)numTaps);
+				stateDown.setSize((int)numberOfChannels, (int)numTaps);
+				stateDown2.setSize((int)numberOfChannels, (int)(numTaps / 4 + 1));
+				position.resize(numberOfChannels);
+			}
+		}
+
+		dsp::AudioBlock<SampleType> getProcessedSamples(size_t numSamples) {
+			return dsp::AudioBlock<SampleType>(buffer).getSubBlock(0, numSamples);
+		}
+
+		SampleType getLatency() const noexcept { return design != nullptr ? design->latency : static_cast<SampleType>(0); }
+
+		void reset() noexcept {
+			buffer.clear();
+			stateUp.clear();
+			stateDown.clear();
+			stateDown2.clear();
+			std::fill(position.begin(), position.end(), 0);
+			std::fill(delayDown.begin(), delayDown.end(), static_cast<SampleType>(0));
+		}
+
+		void processSamplesUp(const dsp::AudioBlock<const SampleType>& inputBlock) noexcept {
+			jassert(inputBlock.getNumChannels() <= (size_t)buffer.getNumChannels());
+			jassert(inputBlock.getNumSamples() * factor <= (size_t)buffer.getNumSamples());
+
+			if (design == nullptr) {
+				for (size_t channel = 0; channel < inputBlock.getNumChannels(); ++channel)
+					buffer.copyFrom((int)channel, 0, inputBlock.getChannelPointer(channel), (int)inputBlock.getNumSamples());
+			}
+			else if (design->type == FilterType::filterHalfBandPolyphaseIIR)
+				processUpIIR(inputBlock);
+			else
+				processUpFIR(inputBlock);
+		}
+
+		void processSamplesDown(dsp::AudioBlock<SampleType>& outputBlock) noexcept {
+			jassert(outputBlock.getNumChannels() <= (size_t)buffer.getNumChannels());
+			jassert(outputBlock.getNumSamples() * factor <= (size_t)buffer.getNumSamples());
+
+			if (design == nullptr) {
+				for (size_t channel = 0; channel < outputBlock.getNumChannels(); ++channel)
+					FloatVectorOperations::copy(outputBlock.getChannelPointer(channel), buffer.getReadPointer((int)channel), (int)outputBlock.getNumSamples());
+			}
+			else if (design->type == FilterType::filterHalfBandPolyphaseIIR)
+				processDownIIR(outputBlock);
+			else
+				processDownFIR(outputBlock);
+		}
+
+		//Half-band FIR: every other tap is zero but the centre one, so each output only takes half the taps
+		void processUpFIR(const dsp::AudioBlock<const SampleType>& inputBlock) noexcept {
+			const auto* fir = design->coefficients.data();
+			const auto N = design->coefficients.size();
+			const auto Ndiv2 = N / 2;
+			const auto numSamples = inputBlock.getNumSamples();
+
+			for (size_t channel = 0; channel < inputBlock.getNumChannels(); ++channel) {
+				auto* bufferSamples = buffer.getWritePointer((int)channel);
+				auto* buf = stateUp.getWritePointer((int)channel);
+				const auto* samples = inputBlock.getChannelPointer(channel);
+
+				for (size_t i = 0; i < numSamples; ++i) {
+					buf[N - 1] = 2 * samples[i];
+
+					auto out = static_cast<SampleType>(0.0);
+
+					for (size_t k = 0; k < Ndiv2; k += 2)
+						out += (buf[k] + buf[N - k - 1]) * fir[k];
+
+					bufferSamples[i << 1] = out;
+					bufferSamples[(i << 1) + 1] = buf[Ndiv2 + 1] * fir[Ndiv2];
+
+					for (size_t k = 0; k < N - 2; k += 2)
+						buf[k] = buf[k + 2];
+				}
+			}
+		}
+
+		void processDownFIR(dsp::AudioBlock<SampleType>& outputBlock) noexcept {
+			const auto* fir = design->coefficients.data();
+			const auto N = design->coefficients.size();
+			const auto Ndiv2 = N / 2;
+			const auto Ndiv4 = Ndiv2 / 2;
+			const auto numSamples = outputBlock.getNumSamples();
+
+			for (size_t channel = 0; channel < outputBlock.getNumChannels(); ++channel) {
+				auto* bufferSamples = buffer.getWritePointer((int)channel);
+				auto* buf = stateDown.getWritePointer((int)channel);
+				auto* buf2 = stateDown2.getWritePointer((int)channel);
+				auto* samples = outputBlock.getChannelPointer(channel);
+				auto pos = position[channel];
+
+				for (size_t i = 0; i < numSamples; ++i) {
+					buf[N - 1] = bufferSamples[i << 1];
+
+					auto out = static_cast<SampleType>(0.0);
+
+					for (size_t k = 0; k < Ndiv2; k += 2)
+						out += (buf[k] + buf[N - k - 1]) * fir[k];
+
+					//the centre tap only ever sees the odd samples, kept in a ring
+					out += buf2[pos] * fir[Ndiv2];
+					buf2[pos] = bufferSamples[(i << 1) + 1];
+
+					samples[i] = out;
+
+					for (size_t k = 0; k < N - 2; ++k)
+						buf[k] = buf[k + 2];
+
+					pos = (pos == 0 ? (int)Ndiv4 : pos - 1);
+				}
+
+				position[channel] = pos;
+			}
+		}
+
+		//Polyphase IIR: two chains of allpass sections, one per phase
+		void processUpIIR(const dsp::AudioBlock<const SampleType>& inputBlock) noexcept {
+			const auto* coeffs = design->coefficients.data();
+			const auto numStages = (int)design->coefficients.size();
+			const auto delayedStages = numStages / 2;
+			const auto directStages = numStages - delayedStages;
+			const auto numSamples = inputBlock.getNumSamples();
+
+			for (size_t channel = 0; channel < inputBlock.getNumChannels(); ++channel) {
+				auto* bufferSamples = buffer.getWritePointer((int)channel);
+				auto* lv1 = stateUp.getWritePointer((int)channel);
+				const auto* samples = inputBlock.getChannelPointer(channel);
+
+				for (size_t i = 0; i < numSamples; ++i) {
+					auto input = samples[i];
+
+					for (int n = 0; n < directStages; ++n) {
+						auto alpha = coeffs[n];
+						auto output = alpha * input + lv1[n];
+						lv1[n] = input - alpha * output;
+						input = output;
+					}
+
+					bufferSamples[i << 1] = input;
+
+					input = samples[i];
+
+					for (int n = directStages; n < numStages; ++n) {
+						auto alpha = coeffs[n];
+						auto output = alpha * input + lv1[n];
+						lv1[n] = input - alpha * output;
+						input = output;
+					}
+
+					bufferSamples[(i << 1) + 1] = input;
+				}
+			}
+
+		   #if JUCE_DSP_ENABLE_SNAP_TO_ZERO
+			snapToZero(stateUp);
+		   #endif
+		}
+
+		void processDownIIR(dsp::AudioBlock<SampleType>& outputBlock) noexcept {
+			const auto* coeffs = design->coefficients.data();
+			const auto numStages = (int)design->coefficients.size();
+			const auto delayedStages = numStages / 2;
+			const auto directStages = numStages - delayedStages;
+			const auto numSamples = outputBlock.getNumSamples();
+
+			for (size_t channel = 0; channel < outputBlock.getNumChannels(); ++channel) {
+				auto* bufferSamples = buffer.getWritePointer((int)channel);
+				auto* lv1 = stateDown.getWritePointer((int)channel);
+				auto* samples = outputBlock.getChannelPointer(channel);
+				auto delayed = delayDown[channel];
+
+				for (size_t i = 0; i < numSamples; ++i) {
+					auto input = bufferSamples[i << 1];
+
+					for (int n = 0; n < directStages; ++n) {
+						auto alpha = coeffs[n];
+						auto output = alpha * input + lv1[n];
+						lv1[n] = input - alpha * output;
+						input = output;
+					}
+
+					auto directOut = input;
+
+					input = bufferSamples[(i << 1) + 1];
+
+					for (int n = directStages; n < numStages; ++n) {
+						auto alpha = coeffs[n];
+						auto output = alpha * input + lv1[n];
+						lv1[n] = input - alpha * output;
+						input = output;
+					}
+
+					samples[i] = (delayed + directOut) * static_cast<SampleType>(0.5);
+					delayed = input;
+				}
+
+				delayDown[channel] = delayed;
+			}
+
+		   #if JUCE_DSP_ENABLE_SNAP_TO_ZERO
+			snapToZero(stateDown);
+		   #endif
+		}
+
+		static void snapToZero(AudioBuffer<SampleType>& state) noexcept {
+			for (int channel = 0; channel < state.getNumChannels(); ++channel) {
+				auto* lv1 = state.getWritePointer(channel);
+
+				for (int n = 0; n < state.getNumSamples(); ++n)
+					JUCE_SNAP_TO_ZERO(lv1[n]);
+			}
+		}
+
+		std::shared_ptr<const K_HalfBandDesign<SampleType>> design; //null for the copying stage
+		size_t factor;
+
+		AudioBuffer<SampleType> buffer; //the stage's output going up, its input coming down
+
+		//FIR: the delay lines, and the ring of odd samples with its read positions going down.
+		//IIR: the allpass states, and the one sample delay of the delayed path going down.
+		AudioBuffer<SampleType> stateUp, stateDown, stateDown2;
+		std::vector<int> position;
+		std::vector<SampleType> delayDown;
+	};
+
+	SampleType getUncompensatedLatency() const noexcept {
+		auto latency = static_cast<SampleType>(0);
+		size_t order = 1;
+
+		for (auto& stage : stages) {
+			order *= stage.factor;
+			latency += stage.getLatency() / static_cast<SampleType>(order);
+		}
+
+		return latency;
+	}
+
+	//Thiran interpolation is only stable from 0.618 samples, so short fractions get a whole sample more
+	void updateDelayLine() {
+		auto latency = getUncompensatedLatency();
+		fractionalDelay = static_cast<SampleType>(1.0) - (latency - std::floor(latency));
+
+		//never above 1, so this is the whole-sample case
+		if (fractionalDelay >= static_cast<SampleType>(1.0))
+			fractionalDelay = static_cast<SampleType>(0.0);
+		else if (fractionalDelay < static_cast<SampleType>(0.618))
+			fractionalDelay += static_cast<SampleType>(1.0);
+
+		delay.setDelay(fractionalDelay);
+	}
+
+	std::vector<Stage> stages;
+	size_t factorOversampling = 1;
+
+	dsp::DelayLine<SampleType, dsp::DelayLineInterpolationTypes::Thiran> delay { 8 };
+	SampleType fractionalDelay = 0;
+
+	JUCE_DECLARE_NON_COPYABLE(K_Oversampler)
+};
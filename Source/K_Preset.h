@@ -0,0 +1,99 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <array>
+using namespace juce;
+
+//Plain values of every parameter at once, in the order of the state format
+template <size_t numParams>
+using K_ParamValues = std::array<float, numParams>;
+
+//A named set of parameter values, for the built in bank
+template <size_t numParams>
+struct K_FactoryPreset {
+	const char* name;
+	K_ParamValues<numParams> values;
+};
+
+//Compact binary state. Little endian, all of it:
+//	uint32 magic, uint16 version, uint16 program, uint16 numValues, float values[numValues]
+//Values are plain (not normalised), in a fixed order that is only ever appended to, so older states load with the
+//newer parameters at their defaults and newer states load in older builds with the extra values ignored.
+namespace K_PresetFormat {
+	constexpr uint32 magic = 0x7453574b; //"KWSt"
+	constexpr int version = 1;
+	constexpr int headerSize = 10;
+
+	template <size_t numParams>
+	void write(MemoryBlock& destData, int program, const K_ParamValues<numParams>& values) {
+		MemoryOutputStream stream(destData, false);
+		stream.writeInt((int)magic);
+		stream.writeShort((short)version);
+		stream.writeShort((short)program);
+		stream.writeShort((short)numParams);
+
+		for (auto value : values)
+			stream.writeFloat(value);
+	}
+
+	//Overwrites the values the data has and leaves the rest. Returns false, touching nothing, if it isn't this format.
+	template <size_t numParams>
+	bool read(const void* data, int sizeInBytes, int& program, K_ParamValues<numParams>& values) {
+		if (data == nullptr || sizeInBytes < headerSize)
+			return false;
+
+		MemoryInputStream stream(data, (size_t)sizeInBytes, false);
+
+		if ((uint32)stream.readInt() != magic)
+			return false;
+
+		//a future version may change the layout, not just append
+		if ((int)(unsigned short)stream.readShort() > version)
+			return false;
+
+		const auto storedProgram = (int)(unsigned short)stream.readShort();
+		const auto numValues = (int)(unsigned short)stream.readShort();
+
+		if (sizeInBytes < headerSize + numValues * (int)sizeof(float))
+			return false;
+
+		program = storedProgram;
+
+		for (int i = 0; i < jmin(numValues, (int)numParams); ++i)
+			values[(size_t)i] = stream.readFloat();
+
+		return true;
+	}
+}
+
+//Single writer, single reader exchange of whole values: the reader always gets the latest complete value the writer
+//published, never a mix of two. Three slots, so neither side waits or allocates: the writer fills its own slot and swaps
+//it with the middle one, the reader swaps its slot with the middle one when there is something new.
+template <typename T>
+class K_SnapshotExchange {
+public:
+	//Writer thread
+	void publish(const T& value) {
+		slots[(size_t)back] = value;
+		back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+	}
+
+	//Reader thread. Takes the latest value if one was published since the last call, returns false otherwise.
+	bool take(T& value) {
+		if ((middle.load(std::memory_order_relaxed) & freshBit) == 0)
+			return false;
+
+		front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+		value = slots[(size_t)front];
+		return true;
+	}
+
+private:
+	constexpr static int freshBit = 4,
+		indexMask = 3;
+
+	std::array<T, 3> slots {};
+	std::atomic<int> middle { 1 };
+
+	int front = 0, //reader only
+		back = 2; //writer only
+};
@@ -0,0 +1,356 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+using namespace juce;
+
+//Per-stage timing of processBlock. Built with KWIRE_PROFILING=1, the K_PROFILE_ macros time their scope with the CPU's
+//cycle counter into lock-free histograms that any thread can read, and keep the latest blocks for a Chrome trace.
+//Without it the macros expand to nothing and none of this is instantiated.
+#ifndef KWIRE_PROFILING
+ #define KWIRE_PROFILING 0
+#endif
+
+//Stages of one processBlock, in signal order. Input and output metering run in the same passes as the gains.
+enum class K_Stage { inputGain, upsample, compress, overdrive, downsample, output, count };
+
+namespace K_Cycles {
+	//Cycle counter: the time stamp counter on x86, the virtual counter on ARM64, the steady clock elsewhere
+	inline uint64 now() noexcept {
+	   #if JUCE_INTEL
+		return (uint64)__rdtsc();
+	   #elif defined(__aarch64__)
+		uint64 ticks;
+		asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+		return ticks;
+	   #else
+		return (uint64)std::chrono::steady_clock::now().time_since_epoch().count();
+	   #endif
+	}
+
+	//Measured once against the steady clock, which takes a few ms. Call it off the audio thread first.
+	inline double getTicksPerSecond() {
+		static const double ticksPerSecond = [] {
+			using Clock = std::chrono::steady_clock;
+
+			const auto clockStart = Clock::now();
+			const auto start = now();
+
+			while (Clock::now() - clockStart < std::chrono::milliseconds(20)) {}
+
+			const auto seconds = std::chrono::duration<double>(Clock::now() - clockStart).count();
+			return (double)(now() - start) / seconds;
+		}();
+
+		return ticksPerSecond;
+	}
+
+	//Shared zero for every trace, so instances line up in one file
+	inline uint64 getEpoch() {
+		static const uint64 epoch = now();
+		return epoch;
+	}
+}
+
+//Totals for one stage, copied out of a K_Profiler
+struct K_StageStats {
+	uint64 blocks = 0, //blocks the stage ran in
+		overruns = 0; //over-budget blocks where this stage took the most time
+
+	double meanUs = 0.0,
+		p99Us = 0.0, //histogram resolution, a quarter octave
+		maxUs = 0.0;
+};
+
+struct K_ProfilerStats {
+	int instance = 0;
+	uint64 blocks = 0,
+		overruns = 0; //blocks over budget
+	double budgetUsed = 0.0; //worst block time over its budget
+
+	std::array<K_StageStats, (size_t)K_Stage::count> stages;
+};
+
+class K_Profiler {
+public:
+	constexpr static int numStages = (int)K_Stage::count;
+
+	K_Profiler() : instance(++numInstances), blocks((size_t)traceCapacity) {}
+
+	//Message thread. A block over budgetFraction of its own duration counts as an overrun.
+	void prepare(double sampleRate, double budgetFraction = 0.5) {
+		ticksPerSecond = K_Cycles::getTicksPerSecond();
+		K_Cycles::getEpoch();
+		budgetTicksPerSample = ticksPerSecond * budgetFraction / sampleRate;
+	}
+
+	static const char* getStageName(K_Stage stage) {
+		constexpr const char* names[] = { "inputGain", "upsample", "compress", "overdrive", "downsample", "output" };
+		return names[(int)stage];
+	}
+
+	//Audio thread, through K_PROFILE_BLOCK
+	void beginBlock(int numSamples) noexcept {
+		auto& block = blocks[(size_t)(written.load(std::memory_order_relaxed) & (traceCapacity - 1))];
+		block = {};
+		block.numSamples = numSamples;
+		block.start = K_Cycles::now();
+	}
+
+	//Audio thread, through K_PROFILE_STAGE. A stage that runs several times in a block, like compress and overdrive
+	//in each control segment, adds up.
+	void addStage(K_Stage stage, uint64 start, uint64 end) noexcept {
+		auto& block = blocks[(size_t)(written.load(std::memory_order_relaxed) & (traceCapacity - 1))];
+		const auto index = (size_t)stage;
+
+		if (block.stageTicks[index] == 0)
+			block.stageStart[index] = start;
+
+		block.stageTicks[index] += jmax((uint64)1, end - start);
+	}
+
+	void endBlock() noexcept {
+		const auto index = written.load(std::memory_order_relaxed);
+		auto& block = blocks[(size_t)(index & (traceCapacity - 1))];
+		block.end = K_Cycles::now();
+
+		const auto ticks = block.end - block.start;
+		const auto budget = (double)block.numSamples * budgetTicksPerSample;
+		size_t slowest = 0;
+
+		for (size_t stage = 0; stage < (size_t)numStages; ++stage) {
+			if (block.stageTicks[stage] == 0)
+				continue;
+
+			stages[stage].record(block.stageTicks[stage]);
+
+			if (block.stageTicks[stage] > block.stageTicks[slowest])
+				slowest = stage;
+		}
+
+		bump(numBlocks);
+
+		if (budget > 0.0) {
+			const auto used = (double)ticks / budget;
+
+			if (used > 1.0) {
+				bump(numOverruns);
+				bump(stages[slowest].overruns);
+			}
+
+			if (used > worstBudgetUsed.load(std::memory_order_relaxed))
+				worstBudgetUsed.store(used, std::memory_order_relaxed);
+		}
+
+		written.store(index + 1, std::memory_order_release);
+	}
+
+	//Any thread. The histograms are written without locks, so a copy taken while processing may be a block behind in places.
+	K_ProfilerStats getStats() const {
+		K_ProfilerStats stats;
+		stats.instance = instance;
+		stats.blocks = numBlocks.load(std::memory_order_relaxed);
+		stats.overruns = numOverruns.load(std::memory_order_relaxed);
+		stats.budgetUsed = worstBudgetUsed.load(std::memory_order_relaxed);
+
+		const auto usPerTick = ticksPerSecond > 0.0 ? 1.0e6 / ticksPerSecond : 0.0;
+
+		for (size_t stage = 0; stage < (size_t)numStages; ++stage) {
+			auto& histogram = stages[stage];
+			auto& out = stats.stages[stage];
+
+			out.blocks = histogram.count.load(std::memory_order_relaxed);
+			out.overruns = histogram.overruns.load(std::memory_order_relaxed);
+
+			if (out.blocks == 0)
+				continue;
+
+			out.meanUs = (double)histogram.totalTicks.load(std::memory_order_relaxed) / (double)out.blocks * usPerTick;
+			out.maxUs = (double)histogram.maxTicks.load(std::memory_order_relaxed) * usPerTick;
+			out.p99Us = jmin(out.maxUs, (double)histogram.getPercentileTicks(0.99, out.blocks) * usPerTick);
+		}
+
+		return stats;
+	}
+
+	//Chrome trace / Perfetto events (the JSON "traceEvents" array entries, comma separated) for the latest blocks: one
+	//process per instance, processBlock with its stages inside. Stages that interleave within a block, compress and
+	//overdrive, are drawn back to back with their summed time. Call it once processing has stopped.
+	void writeTraceEvents(OutputStream& out, bool& first) const {
+		const auto end = written.load(std::memory_order_acquire);
+		const auto begin = end > (uint64)traceCapacity ? end - (uint64)traceCapacity : 0;
+		const auto epoch = K_Cycles::getEpoch();
+		const auto usPerTick = ticksPerSecond > 0.0 ? 1.0e6 / ticksPerSecond : 0.0;
+
+		auto event = [&](const char* name, uint64 start, uint64 ticks, int numSamples) {
+			out << (first ? "" : ",\n") << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":" << instance << ",\"tid\":0"
+				<< ",\"ts\":" << String((double)(start - epoch) * usPerTick, 3) << ",\"dur\":" << String((double)ticks * usPerTick, 3);
+
+			if (numSamples > 0)
+				out << ",\"args\":{\"samples\":" << numSamples << "}";
+
+			out << "}";
+			first = false;
+		};
+
+		out << (first ? "" : ",\n") << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << instance
+			<< ",\"args\":{\"name\":\"K-wire #" << instance << "\"}}";
+		first = false;
+
+		for (auto index = begin; index < end; ++index) {
+			auto& block = blocks[(size_t)(index & (traceCapacity - 1))];
+			event("processBlock", block.start, block.end - block.start, block.numSamples);
+
+			uint64 previousEnd = 0;
+
+			for (size_t stage = 0; stage < (size_t)numStages; ++stage) {
+				if (block.stageTicks[stage] == 0)
+					continue;
+
+				const auto start = jmax(block.stageStart[stage], previousEnd);
+				event(getStageName((K_Stage)stage), start, block.stageTicks[stage], 0);
+				previousEnd = start + block.stageTicks[stage];
+			}
+		}
+	}
+
+	int getInstance() const { return instance; }
+
+private:
+	//Single writer histogram of ticks in quarter octaves
+	struct Histogram {
+		constexpr static int numBuckets = 160;
+
+		std::atomic<uint64> count { 0 },
+			totalTicks { 0 },
+			maxTicks { 0 },
+			overruns { 0 };
+
+		std::array<std::atomic<uint32>, numBuckets> buckets {};
+
+		void record(uint64 ticks) noexcept {
+			bump(count);
+			totalTicks.store(totalTicks.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+
+			if (ticks > maxTicks.load(std::memory_order_relaxed))
+				maxTicks.store(ticks, std::memory_order_relaxed);
+
+			auto& bucket = buckets[(size_t)getBucket(ticks)];
+			bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+
+		//Upper edge of the bucket the fraction falls in
+		uint64 getPercentileTicks(double fraction, uint64 total) const {
+			const auto target = (uint64)std::ceil(fraction * (double)total);
+			uint64 sum = 0;
+
+			for (int bucket = 0; bucket < numBuckets - 1; ++bucket) {
+				sum += buckets[(size_t)bucket].load(std::memory_order_relaxed);
+
+				if (sum >= target)
+					return getBucketStart(bucket + 1);
+			}
+
+			return maxTicks.load(std::memory_order_relaxed);
+		}
+
+		//0 to 3 exactly, then four buckets per octave
+		static int getBucket(uint64 ticks) noexcept {
+			if (ticks < 4)
+				return (int)ticks;
+
+			int octave = 0;
+
+			for (int shift = 32; shift > 0; shift >>= 1)
+				if ((ticks >> (octave + shift)) != 0)
+					octave += shift;
+
+			const auto quarter = (int)(ticks >> (octave - 2)) & 3;
+			return jmin(numBuckets - 1, (octave - 1) * 4 + quarter);
+		}
+
+		static uint64 getBucketStart(int bucket) noexcept {
+			if (bucket < 4)
+				return (uint64)bucket;
+
+			return (uint64)(4 + bucket % 4) << (bucket / 4 - 1);
+		}
+	};
+
+	struct BlockRecord {
+		uint64 start = 0,
+			end = 0;
+		int numSamples = 0;
+		std::array<uint64, (size_t)numStages> stageStart {},
+			stageTicks {};
+	};
+
+	//only the audio thread writes, so a load and a store is enough and cheaper than a read-modify-write
+	template <typename T>
+	static void bump(std::atomic<T>& value) noexcept {
+		value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	constexpr static int traceCapacity = 1 << 14; //latest blocks kept for the trace, a power of two
+
+	inline static std::atomic<int> numInstances { 0 };
+
+	const int instance;
+	double ticksPerSecond = 0.0,
+		budgetTicksPerSample = 0.0;
+
+	std::array<Histogram, (size_t)numStages> stages;
+	std::atomic<uint64> numBlocks { 0 },
+		numOverruns { 0 };
+	std::atomic<double> worstBudgetUsed { 0.0 };
+
+	std::vector<BlockRecord> blocks; //trace ring, audio thread only until writeTraceEvents
+	std::atomic<uint64> written { 0 };
+
+	JUCE_DECLARE_NON_COPYABLE(K_Profiler)
+};
+
+//Times its scope into one stage
+class K_StageTimer {
+public:
+	K_StageTimer(K_Profiler* profilerToUse, K_Stage stageToTime) noexcept
+		: profiler(profilerToUse), stage(stageToTime), start(K_Cycles::now()) {}
+
+	~K_StageTimer() noexcept {
+		if (profiler != nullptr)
+			profiler->addStage(stage, start, K_Cycles::now());
+	}
+
+private:
+	K_Profiler* profiler;
+	K_Stage stage;
+	uint64 start;
+};
+
+//Brackets one processBlock
+class K_BlockTimer {
+public:
+	K_BlockTimer(K_Profiler& profilerToUse, int numSamples) noexcept : profiler(profilerToUse) { profiler.beginBlock(numSamples); }
+	~K_BlockTimer() noexcept { profiler.endBlock(); }
+
+private:
+	K_Profiler& profiler;
+};
+
+#if KWIRE_PROFILING
+ #define K_PROFILE_BLOCK(profiler, numSamples) const K_BlockTimer JUCE_JOIN_MACRO(blockTimer, __LINE__) ((profiler), (numSamples))
+ #define K_PROFILE_STAGE(profiler, stage) const K_StageTimer JUCE_JOIN_MACRO(stageTimer, __LINE__) ((profiler), (stage))
+#else
+ #define K_PROFILE_BLOCK(profiler, numSamples)
+ #define K_PROFILE_STAGE(profiler, stage)
+#endif
@@ -0,0 +1,132 @@
+#include "K_RealtimeCheck.h"
+
+#if KWIRE_REALTIME_CHECKS
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if JUCE_LINUX
+ #include <dlfcn.h>
+ #include <pthread.h>
+#endif
+
+namespace {
+	//nesting depth of Scope on this thread. Plain thread_local int, so reading it never allocates.
+	thread_local int realtimeDepth = 0;
+
+	void check(const char* what) noexcept {
+		if (realtimeDepth > 0)
+			K_RealtimeCheck::fail(what);
+	}
+
+	void* allocate(std::size_t size) {
+		check("heap allocation");
+
+		if (auto* ptr = std::malloc(size > 0 ? size : 1))
+			return ptr;
+
+		throw std::bad_alloc();
+	}
+
+	void* allocateAligned(std::size_t size, std::size_t alignment) {
+		check("heap allocation");
+		size = size > 0 ? size : 1;
+
+	   #if JUCE_WINDOWS
+		void* ptr = _aligned_malloc(size, alignment);
+	   #else
+		void* ptr = nullptr;
+
+		if (posix_memalign(&ptr, alignment > sizeof(void*) ? alignment : sizeof(void*), size) != 0)
+			ptr = nullptr;
+	   #endif
+
+		if (ptr != nullptr)
+			return ptr;
+
+		throw std::bad_alloc();
+	}
+
+	void release(void* ptr) noexcept {
+		if (ptr != nullptr)
+			check("heap free");
+
+		std::free(ptr);
+	}
+
+	void releaseAligned(void* ptr) noexcept {
+		if (ptr != nullptr)
+			check("heap free");
+
+	   #if JUCE_WINDOWS
+		_aligned_free(ptr);
+	   #else
+		std::free(ptr);
+	   #endif
+	}
+}
+
+namespace K_RealtimeCheck {
+	Scope::Scope() noexcept { ++realtimeDepth; }
+	Scope::~Scope() noexcept { --realtimeDepth; }
+
+	bool isRealtime() noexcept { return realtimeDepth > 0; }
+
+	void fail(const char* what) noexcept {
+		//reporting allocates, and must not come back here
+		realtimeDepth = 0;
+
+		std::fprintf(stderr, "K-wire: %s on the audio thread\n%s\n", what, SystemStats::getStackBacktrace().toRawUTF8());
+		std::fflush(stderr);
+
+		jassertfalse;
+		std::abort();
+	}
+}
+
+//Replacements for every form of the global operator new and delete
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { try { return allocate(size); } catch (...) { return nullptr; } }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { try { return allocate(size); } catch (...) { return nullptr; } }
+void operator delete(void* ptr) noexcept { release(ptr); }
+void operator delete[](void* ptr) noexcept { release(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { release(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { release(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { release(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { release(ptr); }
+
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocateAligned(size, (std::size_t)alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocateAligned(size, (std::size_t)alignment); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { try { return allocateAligned(size, (std::size_t)alignment); } catch (...) { return nullptr; } }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { try { return allocateAligned(size, (std::size_t)alignment); } catch (...) { return nullptr; } }
+void operator delete(void* ptr, std::align_val_t) noexcept { releaseAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { releaseAligned(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { releaseAligned(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { releaseAligned(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { releaseAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { releaseAligned(ptr); }
+
+#if JUCE_LINUX
+namespace {
+	using LockFunction = int (*)(pthread_mutex_t*);
+
+	//libc's, looked up on first use. Constant initialised, so there is no static guard to lock.
+	std::atomic<LockFunction> realLock { nullptr };
+}
+
+//CriticalSection, std::mutex and the rest all come down to this. Defined in the executable, it is found before libc's.
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex) {
+	check("mutex lock");
+
+	auto lock = realLock.load(std::memory_order_acquire);
+
+	if (lock == nullptr) {
+		lock = (LockFunction)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+		realLock.store(lock, std::memory_order_release);
+	}
+
+	return lock(mutex);
+}
+#endif
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+#include <juce_core/juce_core.h>
+
+//Debug and test check that the audio thread never touches the heap or blocks on a lock. With KWIRE_REALTIME_CHECKS=1,
+//any allocation or free made inside a K_RealtimeCheck::Scope (and on Linux, any mutex lock) prints what happened with a
+//stack trace and aborts. Without it, the scope compiles to nothing.
+//Allocations are caught by replacing the global operator new and delete, so it holds for the standalone app and the
+//tools. In a Linux plugin the host's own allocator may be bound first.
+#ifndef KWIRE_REALTIME_CHECKS
+ #define KWIRE_REALTIME_CHECKS 0
+#endif
+
+namespace K_RealtimeCheck {
+#if KWIRE_REALTIME_CHECKS
+	//Marks the calling thread as realtime for the scope's lifetime. Scopes nest.
+	struct Scope {
+		Scope() noexcept;
+		~Scope() noexcept;
+
+		JUCE_DECLARE_NON_COPYABLE(Scope)
+	};
+
+	//Whether the calling thread is inside a Scope
+	bool isRealtime() noexcept;
+
+	//Reports the violation and aborts
+	[[noreturn]] void fail(const char* what) noexcept;
+#else
+	struct Scope {
+		Scope() noexcept {}
+	};
+#endif
+}
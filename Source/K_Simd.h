@@ -0,0 +1,277 @@
+#pragma once
+#include <juce_core/juce_core.h>
+using namespace juce;
+
+//Instruction set detection
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP == 2)
+ #define KWIRE_SIMD_X86 1
+ #include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+ #define KWIRE_SIMD_NEON 1
+ #include <arm_neon.h>
+#endif
+
+//Code between these markers may use AVX2 intrinsics. MSVC accepts them anywhere, GCC and Clang need the functions tagged.
+#if KWIRE_SIMD_X86 && defined(__clang__)
+ #define KWIRE_BEGIN_AVX2 _Pragma("clang attribute push (__attribute__((target(\"avx2\"))), apply_to = function)")
+ #define KWIRE_END_AVX2 _Pragma("clang attribute pop")
+#elif KWIRE_SIMD_X86 && defined(__GNUC__)
+ #define KWIRE_BEGIN_AVX2 _Pragma("GCC push_options") _Pragma("GCC target(\"avx2\")")
+ #define KWIRE_END_AVX2 _Pragma("GCC pop_options")
+#else
+ #define KWIRE_BEGIN_AVX2
+ #define KWIRE_END_AVX2
+#endif
+
+namespace K_Simd {
+	enum class InstructionSet { scalar, sse2, avx2, neon };
+
+	//Widest register any instruction set uses, in floats. State arrays are padded to a multiple of this.
+	constexpr int maxLanes = 8;
+
+	constexpr int padToLanes(int numChannels) {
+		return ((numChannels + maxLanes - 1) / maxLanes) * maxLanes;
+	}
+
+	//Picks the instruction set for the host CPU. Wider registers only pay off once there are enough channels to fill them.
+	inline InstructionSet getBestInstructionSet(int numChannels) {
+#if KWIRE_SIMD_X86
+		if (numChannels > 4 && SystemStats::hasAVX2())
+			return InstructionSet::avx2;
+
+		if (SystemStats::hasSSE2())
+			return InstructionSet::sse2;
+#elif KWIRE_SIMD_NEON
+		ignoreUnused(numChannels);
+		return InstructionSet::neon;
+#endif
+		ignoreUnused(numChannels);
+		return InstructionSet::scalar;
+	}
+
+	inline bool isAvailable(InstructionSet set) {
+		switch (set) {
+		case InstructionSet::scalar: return true;
+#if KWIRE_SIMD_X86
+		case InstructionSet::sse2: return SystemStats::hasSSE2();
+		case InstructionSet::avx2: return SystemStats::hasAVX2();
+		case InstructionSet::neon: return false;
+#elif KWIRE_SIMD_NEON
+		case InstructionSet::neon: return true;
+		case InstructionSet::sse2:
+		case InstructionSet::avx2: return false;
+#else
+		case InstructionSet::sse2:
+		case InstructionSet::avx2:
+		case InstructionSet::neon: return false;
+#endif
+		}
+
+		return false;
+	}
+
+	//Each register type below exposes the same static interface, which the generic kernels in K_KwireKernels.h are written against.
+	//R is the register, M a lane mask. load and store are aligned, the Unaligned versions take any address.
+
+	//One lane, for modes the plain scalar loops don't cover
+	namespace scalar {
+		struct Vec {
+			using R = float;
+			using M = bool;
+			static constexpr int width = 1;
+
+			static inline R load(const float* p) { return *p; }
+			static inline void store(float* p, R v) { *p = v; }
+			static inline R loadUnaligned(const float* p) { return *p; }
+			static inline void storeUnaligned(float* p, R v) { *p = v; }
+			static inline R set(float v) { return v; }
+
+			static inline R add(R a, R b) { return a + b; }
+			static inline R sub(R a, R b) { return a - b; }
+			static inline R mul(R a, R b) { return a * b; }
+			static inline R div(R a, R b) { return a / b; }
+			static inline R min(R a, R b) { return b < a ? b : a; }
+			static inline R max(R a, R b) { return a < b ? b : a; }
+			static inline R abs(R v) { return std::abs(v); }
+
+			static inline M gt(R a, R b) { return a > b; }
+			static inline M ge(R a, R b) { return a >= b; }
+			static inline M lt(R a, R b) { return a < b; }
+			static inline R select(M m, R a, R b) { return m ? a : b; }
+
+			static inline R truncate(R v) { return (float)(int32_t)v; }
+
+			static inline R exponent(R v) {
+				uint32_t bits;
+				std::memcpy(&bits, &v, sizeof(bits));
+				return (float)((int32_t)(bits >> 23) - 127);
+			}
+
+			static inline R mantissa(R v) {
+				uint32_t bits;
+				std::memcpy(&bits, &v, sizeof(bits));
+				bits = (bits & 0x007fffff) | 0x3f800000;
+				std::memcpy(&v, &bits, sizeof(bits));
+				return v;
+			}
+
+			static inline R pow2(R n) {
+				uint32_t bits = (uint32_t)((int32_t)n + 127) << 23;
+				float v;
+				std::memcpy(&v, &bits, sizeof(bits));
+				return v;
+			}
+
+			//table[index] for integer valued, in-range index
+			static inline R lookup(const float* table, R index) { return table[(int)index]; }
+		};
+	}
+
+#if KWIRE_SIMD_X86
+	namespace sse2 {
+		struct Vec {
+			using R = __m128;
+			using M = __m128;
+			static constexpr int width = 4;
+
+			static inline R load(const float* p) { return _mm_load_ps(p); }
+			static inline void store(float* p, R v) { _mm_store_ps(p, v); }
+			static inline R loadUnaligned(const float* p) { return _mm_loadu_ps(p); }
+			static inline void storeUnaligned(float* p, R v) { _mm_storeu_ps(p, v); }
+			static inline R set(float v) { return _mm_set1_ps(v); }
+
+			static inline R add(R a, R b) { return _mm_add_ps(a, b); }
+			static inline R sub(R a, R b) { return _mm_sub_ps(a, b); }
+			static inline R mul(R a, R b) { return _mm_mul_ps(a, b); }
+			static inline R div(R a, R b) { return _mm_div_ps(a, b); }
+			static inline R min(R a, R b) { return _mm_min_ps(a, b); }
+			static inline R max(R a, R b) { return _mm_max_ps(a, b); }
+			static inline R abs(R v) { return _mm_andnot_ps(_mm_set1_ps(-0.f), v); }
+
+			static inline M gt(R a, R b) { return _mm_cmpgt_ps(a, b); }
+			static inline M ge(R a, R b) { return _mm_cmpge_ps(a, b); }
+			static inline M lt(R a, R b) { return _mm_cmplt_ps(a, b); }
+			static inline R select(M m, R a, R b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+			//Rounds towards zero. Only valid for |v| < 2^31.
+			static inline R truncate(R v) { return _mm_cvtepi32_ps(_mm_cvttps_epi32(v)); }
+
+			//Unbiased exponent of a positive, normal v.
+			static inline R exponent(R v) {
+				return _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(v), 23), _mm_set1_epi32(127)));
+			}
+
+			//v with its exponent cleared, in [1, 2).
+			static inline R mantissa(R v) {
+				return _mm_or_ps(_mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x007fffff))), _mm_set1_ps(1.f));
+			}
+
+			//2^n for integer valued n in [-126, 127].
+			static inline R pow2(R n) {
+				return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23));
+			}
+
+			static inline R lookup(const float* table, R index) {
+				alignas(16) int32_t i[4];
+				_mm_store_si128((__m128i*)i, _mm_cvttps_epi32(index));
+				return _mm_setr_ps(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+			}
+		};
+	}
+
+	KWIRE_BEGIN_AVX2
+	namespace avx2 {
+		struct Vec {
+			using R = __m256;
+			using M = __m256;
+			static constexpr int width = 8;
+
+			static inline R load(const float* p) { return _mm256_load_ps(p); }
+			static inline void store(float* p, R v) { _mm256_store_ps(p, v); }
+			static inline R loadUnaligned(const float* p) { return _mm256_loadu_ps(p); }
+			static inline void storeUnaligned(float* p, R v) { _mm256_storeu_ps(p, v); }
+			static inline R set(float v) { return _mm256_set1_ps(v); }
+
+			static inline R add(R a, R b) { return _mm256_add_ps(a, b); }
+			static inline R sub(R a, R b) { return _mm256_sub_ps(a, b); }
+			static inline R mul(R a, R b) { return _mm256_mul_ps(a, b); }
+			static inline R div(R a, R b) { return _mm256_div_ps(a, b); }
+			static inline R min(R a, R b) { return _mm256_min_ps(a, b); }
+			static inline R max(R a, R b) { return _mm256_max_ps(a, b); }
+			static inline R abs(R v) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), v); }
+
+			static inline M gt(R a, R b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+			static inline M ge(R a, R b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+			static inline M lt(R a, R b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+			static inline R select(M m, R a, R b) { return _mm256_blendv_ps(b, a, m); }
+
+			static inline R truncate(R v) { return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(v)); }
+
+			static inline R exponent(R v) {
+				return _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(v), 23), _mm256_set1_epi32(127)));
+			}
+
+			static inline R mantissa(R v) {
+				return _mm256_or_ps(_mm256_and_ps(v, _mm256_castsi256_ps(_mm256_set1_epi32(0x007fffff))), _mm256_set1_ps(1.f));
+			}
+
+			static inline R pow2(R n) {
+				return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23));
+			}
+
+			static inline R lookup(const float* table, R index) { return _mm256_i32gather_ps(table, _mm256_cvttps_epi32(index), 4); }
+		};
+	}
+	KWIRE_END_AVX2
+#endif
+
+#if KWIRE_SIMD_NEON
+	namespace neon {
+		struct Vec {
+			using R = float32x4_t;
+			using M = uint32x4_t;
+			static constexpr int width = 4;
+
+			static inline R load(const float* p) { return vld1q_f32(p); }
+			static inline void store(float* p, R v) { vst1q_f32(p, v); }
+			static inline R loadUnaligned(const float* p) { return vld1q_f32(p); }
+			static inline void storeUnaligned(float* p, R v) { vst1q_f32(p, v); }
+			static inline R set(float v) { return vdupq_n_f32(v); }
+
+			static inline R add(R a, R b) { return vaddq_f32(a, b); }
+			static inline R sub(R a, R b) { return vsubq_f32(a, b); }
+			static inline R mul(R a, R b) { return vmulq_f32(a, b); }
+			static inline R div(R a, R b) { return vdivq_f32(a, b); }
+			static inline R min(R a, R b) { return vminq_f32(a, b); }
+			static inline R max(R a, R b) { return vmaxq_f32(a, b); }
+			static inline R abs(R v) { return vabsq_f32(v); }
+
+			static inline M gt(R a, R b) { return vcgtq_f32(a, b); }
+			static inline M ge(R a, R b) { return vcgeq_f32(a, b); }
+			static inline M lt(R a, R b) { return vcltq_f32(a, b); }
+			static inline R select(M m, R a, R b) { return vbslq_f32(m, a, b); }
+
+			static inline R truncate(R v) { return vcvtq_f32_s32(vcvtq_s32_f32(v)); }
+
+			static inline R exponent(R v) {
+				return vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_f32(v), 23)), vdupq_n_s32(127)));
+			}
+
+			static inline R mantissa(R v) {
+				return vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(v), vdupq_n_u32(0x007fffff)), vdupq_n_u32(0x3f800000)));
+			}
+
+			static inline R pow2(R n) {
+				return vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23));
+			}
+
+			static inline R lookup(const float* table, R index) {
+				alignas(16) int32_t i[4];
+				vst1q_s32(i, vcvtq_s32_f32(index));
+				float values[4] = { table[i[0]], table[i[1]], table[i[2]], table[i[3]] };
+				return vld1q_f32(values);
+			}
+		};
+	}
+#endif
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <vector>
+using namespace juce;
+
+//Running maximum of |x| over the last window samples, the current one included.
+//Monotonic deque: every sample enters and leaves it once, so the cost per sample is O(1) amortized whatever the window.
+//Memory is allocated in prepare() only.
+class K_WindowMax {
+public:
+	void prepare(int maxWindowInSamples) {
+		capacity = jmax(1, maxWindowInSamples);
+		values.assign((size_t)capacity, 0.f);
+		times.assign((size_t)capacity, 0);
+		setWindow(jmin(window, capacity));
+	}
+
+	void setWindow(int windowInSamples) {
+		jassert(isPositiveAndNotGreaterThan(windowInSamples, capacity));
+		window = jlimit(1, capacity, windowInSamples);
+		reset();
+	}
+
+	int getWindow() const { return window; }
+
+	void reset() {
+		head = 0;
+		size = 0;
+		now = 0;
+	}
+
+	//output may be the same as input. Double input is measured in float.
+	template <typename Sample>
+	void process(const Sample* input, float* output, int numSamples) {
+		jassert(capacity <= (int)values.size());
+
+		for (int sample = 0; sample < numSamples; ++sample) {
+			const float value = std::abs((float)input[sample]);
+
+			//the oldest candidate has left the window. Unsigned differences stay right when the clock wraps.
+			if (size > 0 && now - times[(size_t)head] >= (uint32)window) {
+				head = wrap(head + 1);
+				--size;
+			}
+
+			//candidates no larger than the new value can never be the maximum again
+			while (size > 0 && values[(size_t)wrap(head + size - 1)] <= value)
+				--size;
+
+			const int back = wrap(head + size);
+			values[(size_t)back] = value;
+			times[(size_t)back] = now;
+			++size;
+
+			output[sample] = values[(size_t)head];
+			++now;
+		}
+	}
+
+private:
+	inline int wrap(int index) const { return index >= capacity ? index - capacity : index; }
+
+	std::vector<float> values; //candidates, decreasing from head to back
+	std::vector<uint32> times; //sample clock of each candidate
+
+	int capacity = 1,
+		window = 1,
+		head = 0,
+		size = 0;
+
+	uint32 now = 0;
+};
@@ -23,9 +23,9 @@ KwireAudioProcessorEditor::KwireAudioProcessorEditor(KwireAudioProcessor& p)
     mixKnob(ImageCache::getFromMemory(BinaryData::KnobStrip_png, BinaryData::KnobStrip_pngSize), 128, true, " %", 5, 1.0, juce::Slider::SliderStyle::RotaryVerticalDrag),
     outGainKnob(ImageCache::getFromMemory(BinaryData::KnobStrip_png, BinaryData::KnobStrip_pngSize), 128, true, " db", 5, 1.0, juce::Slider::SliderStyle::RotaryVerticalDrag),
     
-    inMeter(Colour(0xffac0000), Colour(0xff1b1b1b), 60, 5, true),
-    compMeter(Colour(0xffac0000), 60, 5, true),
-    compReductionMeter(Colour(0xffE2D6F3), Colour(0xff1b1b1b), 60, 5, false),
+    inMeter(Colour(0xffac0000), Colour(0xff1b1b1b), 5, true),
+    compMeter(Colour(0xffac0000), 5, true),
+    compReductionMeter(Colour(0xffE2D6F3), Colour(0xff1b1b1b), 5, false),
 
     compGainSliderAttach((*audioProcessor.treestate.getParameter("compGain")), compGainKnob, nullptr),
     compRatioSliderAttach((*audioProcessor.treestate.getParameter("compRatio")), compRatioKnob, nullptr),
@@ -50,9 +50,6 @@ KwireAudioProcessorEditor::KwireAudioProcessorEditor(KwireAudioProcessor& p)
     //fixed aspect ratio
     getConstrainer()->setFixedAspectRatio(ratio);
 
-    //start timer
-    Timer::startTimerHz(60);
-
     //retrieve images from resources
     juce::Image bgImageUnder = juce::ImageCache::getFromMemory(BinaryData::layoutunder_png, BinaryData::layoutunder_pngSize); 
     juce::Image bgImageOver = juce::ImageCache::getFromMemory(BinaryData::layoutover_png, BinaryData::layoutover_pngSize);
@@ -154,13 +151,25 @@ KwireAudioProcessorEditor::KwireAudioProcessorEditor(KwireAudioProcessor& p)
 
     Component::addAndMakeVisible(bgImageComponentOver);
 
+   #if KWIRE_PROFILING
+    //over everything, it is a debug overlay
+    profileOverlay.setFont(Font(Font::getDefaultMonospacedFontName(), 10.f, Font::plain));
+    profileOverlay.setColour(Label::backgroundColourId, Colours::black.withAlpha(0.7f));
+    profileOverlay.setColour(Label::textColourId, Colours::white);
+    profileOverlay.setJustificationType(Justification::topLeft);
+    profileOverlay.setInterceptsMouseClicks(false, false);
+    Component::addAndMakeVisible(profileOverlay);
+   #endif
+
     compReductionMeter.setOpaque(false);
     compMeter.setOpaque(false);
+
+    //hangs from the top, behind the output meter
+    compReductionMeter.setGainReduction(24.f);
 }
 
 KwireAudioProcessorEditor::~KwireAudioProcessorEditor()
 {
-    Timer::stopTimer();
 }
 
 //==============================================================================
@@ -183,12 +192,80 @@ void KwireAudioProcessorEditor::paint (Graphics& g)
     bgImageComponentOver.setBoundsRelative(0, 0, 1, 1);
 }
 
-void KwireAudioProcessorEditor::timerCallback()
+void KwireAudioProcessorEditor::onVBlank()
+{
+    //Meter ballistics were tuned at 60 frames per second, so they advance in 60 Hz steps whatever the display rate
+    constexpr double meterFrameMs = 1000.0 / 60.0;
+    //With the transport stopped and the meters at rest, only look for new activity every few frames
+    constexpr double idleSteps = 6.0;
+
+    auto now = Time::getMillisecondCounterHiRes();
+
+   #if KWIRE_PROFILING
+    //twice a second, even while the meters idle
+    if (now - lastProfileTime >= 500.0) {
+        lastProfileTime = now;
+        updateProfileOverlay();
+    }
+   #endif
+
+    meterSteps += lastFrameTime > 0.0 ? (now - lastFrameTime) / meterFrameMs : 1.0;
+    lastFrameTime = now;
+
+    //a little slack so a display just under 60 Hz doesn't skip every other frame
+    if (meterSteps < (metersIdle ? idleSteps : 0.8))
+        return;
+
+    //catch up on the frames due, but not all at once after a stall
+    auto steps = jlimit(1, (int)idleSteps, (int)meterSteps);
+    meterSteps = jmax(0.0, meterSteps - steps);
+
+    //one bar per channel of the current bus layout
+    auto numChannels = audioProcessor.getMainBusNumInputChannels();
+    inMeter.setNumChannels(numChannels);
+    compReductionMeter.setNumChannels(numChannels);
+    compMeter.setNumChannels(numChannels);
+
+    inMeter.getData(audioProcessor.inLevels);
+    compReductionMeter.getData(audioProcessor.gainReduction);
+    compMeter.getData(audioProcessor.compLevels);
+
+    bool moved = false;
+
+    for (int i = 0; i < steps; ++i)
+    {
+        moved |= inMeter.update();
+        moved |= compReductionMeter.update();
+        moved |= compMeter.update();
+    }
+
+    metersIdle = !moved && !audioProcessor.isTransportPlaying();
+}
+
+#if KWIRE_PROFILING
+void KwireAudioProcessorEditor::updateProfileOverlay()
 {
-    inMeter.getData(audioProcessor.inAudio, audioProcessor.inAudioPeak);
-    compReductionMeter.getData(audioProcessor.preCompAudio);
-    compMeter.getData(audioProcessor.compAudio, audioProcessor.compAudioPeak);
+    auto stats = audioProcessor.profiler.getStats();
+
+    String text;
+    text << "K-wire #" << stats.instance << "  " << (juce::int64)stats.blocks << " blocks, " << (juce::int64)stats.overruns
+         << " over budget, worst " << String(stats.budgetUsed * 100.0, 0) << "% of budget\n"
+         << String("us").paddedRight(' ', 10) << String("mean").paddedLeft(' ', 8) << String("p99").paddedLeft(' ', 8)
+         << String("max").paddedLeft(' ', 8) << String("over").paddedLeft(' ', 6) << "\n";
+
+    for (int stage = 0; stage < K_Profiler::numStages; ++stage) {
+        auto& stageStats = stats.stages[(size_t)stage];
+
+        text << String(K_Profiler::getStageName((K_Stage)stage)).paddedRight(' ', 10)
+             << String(stageStats.meanUs, 1).paddedLeft(' ', 8)
+             << String(stageStats.p99Us, 1).paddedLeft(' ', 8)
+             << String(stageStats.maxUs, 1).paddedLeft(' ', 8)
+             << String((juce::int64)stageStats.overruns).paddedLeft(' ', 6) << "\n";
+    }
+
+    profileOverlay.setText(text, dontSendNotification);
 }
+#endif
 
 void KwireAudioProcessorEditor::resized()
 {
@@ -208,9 +285,9 @@ void KwireAudioProcessorEditor::resized()
 
     bgImageComponentOver.setBoundsRelative(0, 0, 1, 1);
 
-    inMeter.update();
-    compReductionMeter.update();
-    compMeter.update();
+   #if KWIRE_PROFILING
+    profileOverlay.setBoundsRelative(0.f, 0.f, 0.62f, 0.5f);
+   #endif
 }
 
 void KwireAudioProcessorEditor::sliderValueChanged(juce::Slider* slider) //this is where the value from the sliders gets passed to the variable
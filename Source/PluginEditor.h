@@ -6,7 +6,7 @@
 #include "K_Meter.h"
 using namespace juce;
 
-class KwireAudioProcessorEditor  : public juce::AudioProcessorEditor, public juce::Slider::Listener, public Timer
+class KwireAudioProcessorEditor  : public juce::AudioProcessorEditor, public juce::Slider::Listener
 {
 public:
     KwireAudioProcessorEditor (KwireAudioProcessor&);
@@ -15,11 +15,25 @@ public:
     void paint (Graphics&) override;
     void resized() override;    
     void sliderValueChanged(juce::Slider* slider) override;
-    void timerCallback() override;
 
 private:
     KwireAudioProcessor& audioProcessor;
 
+    //Pulls meter data and advances the meters, once per display refresh
+    void onVBlank();
+
+    double lastFrameTime = 0.0,
+        meterSteps = 0.0; //60 Hz meter frames due
+    bool metersIdle = false;
+
+   #if KWIRE_PROFILING
+    //Per-stage timings of this instance, from its K_Profiler
+    void updateProfileOverlay();
+
+    Label profileOverlay;
+    double lastProfileTime = 0.0;
+   #endif
+
     ImageComponent bgImageComponentUnder,
         bgImageComponentOver;
 
@@ -31,7 +45,7 @@ private:
         mixKnob,
         outGainKnob;
 
-    K_Meter<supportedChannels> inMeter,
+    K_Meter<maxSupportedChannels> inMeter,
         compMeter,
         compReductionMeter;
 
@@ -43,5 +57,7 @@ private:
         mixSliderAttach,
         outGainSliderAttach;
 
+    VBlankAttachment vBlankAttachment { this, [this] { onVBlank(); } };
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (KwireAudioProcessorEditor)
 };
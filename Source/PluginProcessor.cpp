@@ -1,6 +1,26 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+namespace {
+    //IDs in KwireParam order
+    const char* const paramIDs[KwireParam::count] = { "compGain", "compRatio", "compThreshold", "compAttack", "compRelease", "mix", "outGain",
+                                                      "oversampling", "osFilter", "linkMode", "sidechain", "lookahead" };
+
+    //Built in bank. Values in KwireParam order: gain, ratio, threshold, attack, release, mix, out gain,
+    //oversampling, filter, link, sidechain, lookahead. The first one is the parameters' defaults.
+    const K_FactoryPreset<KwireParam::count> factoryPresets[] = {
+        { "Default",        { 0.f, 100.f, -12.f, 20.f,  10.f, 100.f,  0.f, 1.f, 0.f, 0.f, 0.f, 0.f } },
+        { "Bus Glue",       { 0.f,  30.f, -18.f, 30.f, 150.f, 100.f,  1.f, 1.f, 0.f, 2.f, 0.f, 0.f } },
+        { "Drum Smash",     { 6.f, 100.f, -20.f,  1.f,  40.f, 100.f, -3.f, 2.f, 0.f, 1.f, 0.f, 0.f } },
+        { "Parallel Crush", { 6.f, 100.f, -24.f, 0.5f, 80.f,  35.f,  0.f, 2.f, 0.f, 1.f, 0.f, 0.f } },
+        { "Vocal Leveler",  { 0.f,  60.f, -16.f,  5.f, 120.f, 100.f,  0.f, 1.f, 0.f, 1.f, 0.f, 2.f } },
+        { "Master Warmth",  { 0.f,  15.f,  -6.f, 50.f, 300.f, 100.f,  0.f, 3.f, 0.f, 2.f, 0.f, 0.f } },
+        { "Sidechain Duck", { 0.f,  80.f, -20.f,  2.f, 200.f, 100.f,  0.f, 1.f, 0.f, 1.f, 1.f, 0.f } },
+    };
+
+    constexpr auto numFactoryPresets = (int)(sizeof(factoryPresets) / sizeof(factoryPresets[0]));
+}
+
 //==============================================================================
 KwireAudioProcessor::KwireAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -8,13 +28,12 @@ KwireAudioProcessor::KwireAudioProcessor()
 #if ! JucePlugin_IsMidiEffect
 #if ! JucePlugin_IsSynth
         .withInput("Input", juce::AudioChannelSet::stereo(), true)
+        .withInput("Sidechain", juce::AudioChannelSet::stereo(), false)
 #endif
         .withOutput("Output", juce::AudioChannelSet::stereo(), true)
 #endif
     ),
-    treestate(*this, nullptr, "PARAMETERS", makeParams()),
-    oversampler(supportedChannels, osFactor, juce::dsp::Oversampling<float>::FilterType::filterHalfBandFIREquiripple, true, true),
-    dryOversampler(supportedChannels, osFactor, juce::dsp::Oversampling<float>::FilterType::filterHalfBandFIREquiripple, true, true)
+    treestate(*this, nullptr, "PARAMETERS", makeParams())
 #endif
 {
     compGain = dynamic_cast<juce::AudioParameterFloat*>(treestate.getParameter("compGain"));
@@ -24,10 +43,29 @@ KwireAudioProcessor::KwireAudioProcessor()
     compRelease = dynamic_cast<juce::AudioParameterFloat*>(treestate.getParameter("compRelease"));
     mix = dynamic_cast<juce::AudioParameterFloat*>(treestate.getParameter("mix"));
     outGain = dynamic_cast<juce::AudioParameterFloat*>(treestate.getParameter("outGain"));
+    oversampling = dynamic_cast<juce::AudioParameterChoice*>(treestate.getParameter("oversampling"));
+    osFilter = dynamic_cast<juce::AudioParameterChoice*>(treestate.getParameter("osFilter"));
+    linkMode = dynamic_cast<juce::AudioParameterChoice*>(treestate.getParameter("linkMode"));
+    sidechain = dynamic_cast<juce::AudioParameterBool*>(treestate.getParameter("sidechain"));
+    lookahead = dynamic_cast<juce::AudioParameterFloat*>(treestate.getParameter("lookahead"));
+
+    for (int index = 0; index < KwireParam::count; ++index)
+        parameters[(size_t)index] = treestate.getParameter(paramIDs[index]);
+
+    treestate.addParameterListener("oversampling", this);
+    treestate.addParameterListener("osFilter", this);
+    treestate.addParameterListener("lookahead", this);
+
+    //picks up the changes parameterChanged flags
+    startTimerHz(reconfigureCheckHz);
 }
 
 KwireAudioProcessor::~KwireAudioProcessor()
 {
+    treestate.removeParameterListener("oversampling", this);
+    treestate.removeParameterListener("osFilter", this);
+    treestate.removeParameterListener("lookahead", this);
+    stopTimer();
 }
 
 //==============================================================================
@@ -65,65 +103,251 @@ bool KwireAudioProcessor::isMidiEffect() const
 
 double KwireAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    if (preparedSampleRate <= 0.0)
+        return 0.0;
+
+    //After the input stops, the wet path rings on through the oversampling filters and the lookahead, and the envelopes
+    //keep moving until they come to rest. Taken at the longest release, since hosts don't always ask again when it changes.
+    auto params = getKwireParams(getParamValues());
+    params.release = compRelease->range.end;
+
+    return K_Kwire<maxSupportedChannels>::getSettleTimeMs(params) * 0.001 / voicingOsFactor + getWetFlushSamples() / preparedSampleRate;
 }
 
 int KwireAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return numFactoryPresets;
 }
 
 int KwireAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram.load();
 }
 
 void KwireAudioProcessor::setCurrentProgram (int index)
 {
+    if (!juce::isPositiveAndBelow(index, numFactoryPresets))
+        return;
+
+    currentProgram = index;
+    recall(factoryPresets[index].values);
 }
 
 const juce::String KwireAudioProcessor::getProgramName (int index)
 {
-    return {};
+    return juce::isPositiveAndBelow(index, numFactoryPresets) ? factoryPresets[index].name : juce::String();
 }
 
 void KwireAudioProcessor::changeProgramName (int index, const juce::String& newName)
 {
+    //the bank is built in
+    juce::ignoreUnused (index, newName);
 }
 
 //==============================================================================
 void KwireAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock) {
-    kwire.setupParams(compRatio->get(), compThreshold->get(), compAttack->get(), compRelease->get(), sampleRate);
+    preparedSampleRate = sampleRate;
+    preparedBlockSize = jmax(1, samplesPerBlock);
+
+   #if KWIRE_PROFILING
+    profiler.prepare(sampleRate);
+   #endif
+
+    if (isUsingDoublePrecision())
+        prepareEngine(doubleEngine, preparedBlockSize);
+    else
+        prepareEngine(floatEngine, preparedBlockSize);
+
+    //start from the current mix rather than fading in from dry
+    prevMix = jlimit(0.f, 100.f, mix->get()) * 0.01f;
+
+    configureOversampling(true);
+}
+
+template <typename SampleType>
+void KwireAudioProcessor::prepareEngine(Engine<SampleType>& engine, int samplesPerBlock) {
+    auto mainNumChannels = getMainBusNumInputChannels();
+
+    //process() never asks for more, longer host blocks are split
+    engine.dryBuffer.setSize(mainNumChannels, samplesPerBlock);
+    engine.kwire.setNumChannels(jlimit(1, maxSupportedChannels, mainNumChannels));
+    //enough for the longest lookahead at the highest oversampling factor, so changing either never allocates on the audio thread
+    engine.kwire.prepareLookahead(getLookaheadSamples(maxLookaheadMs) * (1 << maxOversamplingIndex));
+
+   #if KWIRE_PROFILING
+    engine.kwire.setProfiler(&profiler);
+   #endif
+}
+
+void KwireAudioProcessor::configureOversampling(bool force) {
+    //prepareToPlay will configure it
+    if (preparedSampleRate <= 0.0)
+        return;
+
+    auto factorIndex = oversampling->getIndex();
+    auto filterIndex = osFilter->getIndex();
+    auto lookaheadSamples = getLookaheadSamples(lookahead->get());
+
+    if (!force && factorIndex == activeOversampling && filterIndex == activeOsFilter && lookaheadSamples == activeLookahead)
+        return;
+
+    auto latency = isUsingDoublePrecision() ? configureEngine(doubleEngine, factorIndex, filterIndex, lookaheadSamples)
+                                            : configureEngine(floatEngine, factorIndex, filterIndex, lookaheadSamples);
+
+    activeOversampling = factorIndex;
+    activeOsFilter = filterIndex;
+    activeLookahead = lookaheadSamples;
+
+    setLatencySamples(latency);
+}
+
+template <typename SampleType>
+int KwireAudioProcessor::configureEngine(Engine<SampleType>& engine, int factorIndex, int filterIndex, int lookaheadSamples) {
+    auto numChannels = getMainBusNumInputChannels();
+
+    //build everything off the audio thread
+    auto newOversampler = makeOversampler<SampleType>(numChannels, factorIndex, filterIndex, preparedBlockSize);
+
+    //the sidechain goes through identical filters, so it lines up with the main signal in the oversampled domain
+    std::unique_ptr<K_Oversampler<SampleType>> newSidechainOversampler;
+
+    if (auto sidechainChannels = getSidechainNumChannels(); sidechainChannels > 0)
+        newSidechainOversampler = makeOversampler<SampleType>(sidechainChannels, factorIndex, filterIndex, preparedBlockSize);
+
+    //the dry path only needs the oversampler's and the lookahead's delay, not their processing
+    auto latency = (int)newOversampler->getLatencyInSamples() + lookaheadSamples;
+
+    K_Delay<SampleType> newDryDelay;
+    newDryDelay.prepare(numChannels, latency);
+    newDryDelay.setDelay(latency);
+
+    //read before the swap, which leaves newOversampler holding the old one (or nothing, the first time)
+    const auto factor = (int)newOversampler->getOversamplingFactor();
+    auto engineRate = preparedSampleRate * (double)factor / voicingOsFactor;
+
+    {
+        //swap between two blocks
+        const juce::ScopedLock sl(getCallbackLock());
+
+        engine.oversampler.swap(newOversampler);
+        engine.sidechainOversampler.swap(newSidechainOversampler);
+        std::swap(engine.dryDelay, newDryDelay);
+        engine.kwire.setupParams(getKwireParams(getParamValues()), engineRate);
+        engine.kwire.setLookahead(lookaheadSamples * factor);
+    }
+
+    return latency;
+}
+
+template <typename SampleType>
+std::unique_ptr<K_Oversampler<SampleType>> KwireAudioProcessor::makeOversampler(int numChannels, int factorIndex, int filterIndex, int maxBlockSize) {
+    using FilterType = typename K_Oversampler<SampleType>::FilterType;
+
+    auto filterType = filterIndex == 0 ? FilterType::filterHalfBandFIREquiripple : FilterType::filterHalfBandPolyphaseIIR;
+    auto newOversampler = std::make_unique<K_Oversampler<SampleType>>((size_t)numChannels);
+
+    if (factorIndex == 0)
+        newOversampler->addDummyOversamplingStage();
+
+    for (int stage = 0; stage < factorIndex; ++stage) {
+        //later stages only have to reject images far above the audio band
+        auto transitionWidth = stage == 0 ? 0.15f : 0.3f;
+        auto attenuation = -90.0f + 10.0f * stage;
+
+        newOversampler->addOversamplingStage(filterType, transitionWidth, attenuation);
+    }
+
+    newOversampler->initProcessing((size_t)maxBlockSize);
+
+    return newOversampler;
+}
+
+//for the tools, which build the same oversampler to measure and check it
+template std::unique_ptr<K_Oversampler<float>> KwireAudioProcessor::makeOversampler<float>(int, int, int, int);
+template std::unique_ptr<K_Oversampler<double>> KwireAudioProcessor::makeOversampler<double>(int, int, int, int);
+
+K_KwireParams KwireAudioProcessor::getKwireParams(const KwireParamValues& values) {
+    //Ratio range (1 - 2)
+    return { 1.f + values[KwireParam::compRatio] * 0.01f, values[KwireParam::compThreshold], values[KwireParam::compAttack], values[KwireParam::compRelease] };
+}
+
+KwireParamValues KwireAudioProcessor::getParamValues() const {
+    //in KwireParam order, read straight from the parameters so they come back exactly as set
+    return { compGain->get(), compRatio->get(), compThreshold->get(), compAttack->get(), compRelease->get(), mix->get(), outGain->get(),
+             (float)oversampling->getIndex(), (float)osFilter->getIndex(), (float)linkMode->getIndex(), sidechain->get() ? 1.f : 0.f, lookahead->get() };
+}
+
+KwireParamValues KwireAudioProcessor::getDefaultValues() const {
+    KwireParamValues values;
+
+    for (int index = 0; index < KwireParam::count; ++index)
+        values[(size_t)index] = parameters[(size_t)index]->convertFrom0to1(parameters[(size_t)index]->getDefaultValue());
+
+    return values;
+}
+
+KwireParamValues KwireAudioProcessor::getBlockParams() {
+    //halfway through a recall the parameters are part old, part new. The snapshot it published before starting is whole.
+    //A recall can also start between the check and the read, so the generation is checked again after reading.
+    const auto generation = recallGeneration.load(std::memory_order_acquire);
+
+    if ((generation & 1) == 0) {
+        auto values = getParamValues();
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (recallGeneration.load(std::memory_order_relaxed) == generation)
+            return values;
+    }
+
+    recallSnapshots.take(recalledParams);
+    return recalledParams;
+}
+
+void KwireAudioProcessor::recall(const KwireParamValues& values) {
+    const juce::ScopedLock sl(recallLock);
+
+    //publish first: a block that sees the generation change finds the snapshot already there
+    recallSnapshots.publish(values);
+    recallGeneration.fetch_add(1, std::memory_order_acq_rel);
+
+    for (int index = 0; index < KwireParam::count; ++index) {
+        auto* param = parameters[(size_t)index];
+        auto normalised = param->convertTo0to1(values[(size_t)index]);
+
+        //the host and the attachments only hear about what changes
+        if (param->getValue() != normalised)
+            param->setValueNotifyingHost(normalised);
+    }
 
-    auto totalNumInputChannels = getTotalNumInputChannels();
-    auto totalNumOutputChannels = getTotalNumOutputChannels();
-    
-    inAudio.resize(totalNumInputChannels);
-    inAudioPeak.resize(totalNumInputChannels);
-    compAudio.resize(totalNumInputChannels);
-    compAudioPeak.resize(totalNumInputChannels);
-    preCompAudio.resize(totalNumInputChannels);
+    recallGeneration.fetch_add(1, std::memory_order_release);
+}
 
-    oversampler.numChannels = getTotalNumInputChannels(); //set os numchannels
-    oversampler.setUsingIntegerLatency(true);
-    oversampler.clearOversamplingStages();
+int KwireAudioProcessor::getLookaheadSamples(float lookaheadMs) const {
+    //whole host samples, so the reported latency is exact at every oversampling factor
+    return juce::roundToInt(jlimit(0.f, maxLookaheadMs, lookaheadMs) * preparedSampleRate * 0.001);
+}
 
-    oversampler.addOversamplingStage(juce::dsp::Oversampling<float>::FilterType::filterHalfBandFIREquiripple, 0.15f, -90.0f, 0.15f, -90.0f);
+int KwireAudioProcessor::getWetFlushSamples() const {
+    //a linear phase filter spans twice its latency. Counting the lookahead twice too keeps it simple and errs long.
+    return 2 * getLatencySamples();
+}
 
-    oversampler.reset();
-    oversampler.initProcessing(samplesPerBlock);
+int KwireAudioProcessor::getSidechainNumChannels() const {
+    auto* bus = getBus(true, 1);
 
-    dryOversampler.numChannels = getTotalNumInputChannels(); //set os numchannels
-    dryOversampler.setUsingIntegerLatency(true);
-    dryOversampler.clearOversamplingStages();
+    return bus != nullptr && bus->isEnabled() ? jmin(bus->getNumberOfChannels(), maxSupportedChannels) : 0;
+}
 
-    dryOversampler.addOversamplingStage(juce::dsp::Oversampling<float>::FilterType::filterHalfBandFIREquiripple, 0.15f, -90.0f, 0.15f, -90.0f);
+void KwireAudioProcessor::parameterChanged(const juce::String& parameterID, float newValue) {
+    juce::ignoreUnused(parameterID, newValue);
 
-    dryOversampler.reset();
-    dryOversampler.initProcessing(samplesPerBlock);
-    
-    setLatencySamples(oversampler.getLatencyInSamples());
+    //may arrive on the audio thread, where even posting a message can lock or allocate, so only flag it for the timer
+    reconfigurePending.store(true, std::memory_order_release);
+}
+
+void KwireAudioProcessor::timerCallback() {
+    if (reconfigurePending.exchange(false, std::memory_order_acquire))
+        configureOversampling(false);
 }
 
 void KwireAudioProcessor::releaseResources()
@@ -132,6 +356,29 @@ void KwireAudioProcessor::releaseResources()
     // spare memory, etc.
 }
 
+void KwireAudioProcessor::reset()
+{
+    floatEngine.reset();
+    doubleEngine.reset();
+    silentSamples = 0;
+    wetPathStale = false;
+    wetFadeSamples = 0;
+    sidechainWasOn = false;
+}
+
+template <typename SampleType>
+void KwireAudioProcessor::Engine<SampleType>::reset()
+{
+    kwire.reset();
+    dryDelay.reset();
+
+    if (oversampler != nullptr)
+        oversampler->reset();
+
+    if (sidechainOversampler != nullptr)
+        sidechainOversampler->reset();
+}
+
 #ifndef JucePlugin_PreferredChannelConfigurations
 bool KwireAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
@@ -139,14 +386,21 @@ bool KwireAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) co
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Any main layout from mono up to maxSupportedChannels, e.g. 5.1, 7.1.4 or discrete channels.
+    // Every channel goes through the same processing, so the speaker arrangement doesn't matter.
+    const auto numChannels = layouts.getMainOutputChannelSet().size();
+
+    if (numChannels < 1 || numChannels > maxSupportedChannels)
         return false;
 
+    // The sidechain can be off, or any width up to the same limit.
+    if (layouts.inputBuses.size() > 1) {
+        const auto sidechainChannels = layouts.getChannelSet(true, 1).size();
+
+        if (sidechainChannels > maxSupportedChannels)
+            return false;
+    }
+
     // This checks if the input layout matches the output layout
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
@@ -159,67 +413,239 @@ bool KwireAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) co
 #endif
 
 void KwireAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) {
+    juce::ignoreUnused (midiMessages);
+    process(buffer, floatEngine);
+}
+
+void KwireAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages) {
+    juce::ignoreUnused (midiMessages);
+    process(buffer, doubleEngine);
+}
+
+void KwireAudioProcessor::processBlockBypassed (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) {
+    juce::ignoreUnused (midiMessages);
+    processBypassed(buffer, floatEngine);
+}
+
+void KwireAudioProcessor::processBlockBypassed (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages) {
+    juce::ignoreUnused (midiMessages);
+    processBypassed(buffer, doubleEngine);
+}
+
+//The input comes out as late as processed output would, through the dry delay, so the host's latency compensation
+//still holds and toggling bypass doesn't jump. The wet path isn't fed meanwhile, so it is cleared when processing resumes
+//and the output crossfades back from the dry signal while it refills.
+template <typename SampleType>
+void KwireAudioProcessor::processBypassed(juce::AudioBuffer<SampleType>& buffer, Engine<SampleType>& engine) {
+    K_RealtimeCheck::Scope realtime;
+    auto mainBuffer = getBusBuffer(buffer, true, 0);
+    auto numChannels = jmin(mainBuffer.getNumChannels(), maxSupportedChannels);
+
+    engine.dryDelay.process(mainBuffer.getArrayOfReadPointers(), mainBuffer.getArrayOfWritePointers(), numChannels, buffer.getNumSamples());
+
+    silentSamples = 0;
+    wetPathStale = true;
+}
+
+//Both precisions run the same path. Gains, meters and the compressor's envelopes stay float either way.
+template <typename SampleType>
+void KwireAudioProcessor::process(juce::AudioBuffer<SampleType>& buffer, Engine<SampleType>& engine) {
     juce::ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels  = getTotalNumInputChannels();
-    //auto totalNumOutputChannels = getTotalNumOutputChannels();
+    K_RealtimeCheck::Scope realtime;
+
+    if (auto* playHead = getPlayHead())
+        if (auto position = playHead->getPosition())
+            transportPlaying.store(position->getIsPlaying(), std::memory_order_relaxed);
+
+    //left over from before a bypass
+    if (wetPathStale) {
+        engine.oversampler->reset();
+
+        if (engine.sidechainOversampler != nullptr)
+            engine.sidechainOversampler->reset();
+
+        engine.kwire.setLookahead(engine.kwire.getLookahead());
+        wetPathStale = false;
 
-    //send input to in meter
-    for (int channel = 0; channel < supportedChannels; ++channel) {
-        inAudio[channel].set(buffer.getRMSLevel(channel, 0, buffer.getNumSamples()));
-        inAudioPeak[channel].set(buffer.getMagnitude(channel, 0, buffer.getNumSamples()));
+        //start from the dry signal, the wet path is empty
+        prevMix = 0.f;
+        wetFadeSamples = getLatencySamples() + jmax(getLatencySamples(), minWetFadeSamples);
     }
 
-    //Make a copy of the buffer at this point
-    dryBuffer.makeCopyOf(buffer);
+    //one snapshot of the parameters for the whole block, the engine ramps to it
+    const auto params = getBlockParams();
+
+    K_PROFILE_BLOCK(profiler, buffer.getNumSamples());
+
+    //Hosts may send more than the samplesPerBlock they prepared with. The oversamplers and the dry buffer are sized
+    //for that much only, so longer blocks go through in pieces of it.
+    const auto numSamples = buffer.getNumSamples();
+
+    //Main bus, and the sidechain's channels that come after it in the host's buffer
+    auto mainBus = getBusBuffer(buffer, true, 0);
+    auto sidechainBus = getBusBuffer(buffer, true, 1);
+
+    for (int start = 0; start < numSamples; start += preparedBlockSize) {
+        //views of the host's channels. A bus is at most maxSupportedChannels wide, which fits AudioBuffer's
+        //preallocated channel pointers, so they don't allocate either.
+        const auto chunkSize = jmin(preparedBlockSize, numSamples - start);
+        juce::AudioBuffer<SampleType> mainBuffer(mainBus.getArrayOfWritePointers(), mainBus.getNumChannels(), start, chunkSize),
+            sidechainBuffer(sidechainBus.getArrayOfWritePointers(), sidechainBus.getNumChannels(), start, chunkSize);
+
+        processChunk(mainBuffer, sidechainBuffer, engine, params);
+    }
+}
+
+template <typename SampleType>
+void KwireAudioProcessor::processChunk(juce::AudioBuffer<SampleType>& mainBuffer, juce::AudioBuffer<SampleType>& sidechainBuffer,
+                                       Engine<SampleType>& engine, const KwireParamValues& params) {
+    auto& kwire = engine.kwire;
+
+    //Layouts wider than the engine are refused, this only guards against a host ignoring that
+    auto numChannels = jmin(mainBuffer.getNumChannels(), maxSupportedChannels);
+
+    const auto numSamples = mainBuffer.getNumSamples();
+
+    //Delayed copy of the buffer at this point, time-aligned with the oversampled path, in the space prepareToPlay made
+    auto* const* dryChannels = engine.dryBuffer.getArrayOfWritePointers();
+    engine.dryDelay.process(mainBuffer.getArrayOfReadPointers(), dryChannels, numChannels, numSamples);
     //Point block to the buffer
-    juce::dsp::AudioBlock<float> block(buffer); 
-    //Point dry block at buffer copy before processing
-    juce::dsp::AudioBlock<float> dryBlock(dryBuffer); 
+    juce::dsp::AudioBlock<SampleType> block(mainBuffer.getArrayOfWritePointers(), (size_t)numChannels, (size_t)numSamples);
+    //Point dry block at the delayed copy
+    juce::dsp::AudioBlock<SampleType> dryBlock(dryChannels, (size_t)numChannels, (size_t)numSamples);
+
+    //Input gain ramp, metering the input in the same pass
+    auto compGain_ = juce::Decibels::decibelsToGain(params[KwireParam::compGain]);
+    const auto compGainStep = (compGain_ - prevCompGain) / (float)numSamples;
+
+    K_MeterBlock<maxSupportedChannels> inBlock;
+    inBlock.numSamples = numSamples;
+    float inputPeak = 0.f;
+
+    {
+        K_PROFILE_STAGE(&profiler, K_Stage::inputGain);
+
+        for (int channel = 0; channel < numChannels; ++channel) {
+            auto* channelData = mainBuffer.getWritePointer(channel);
+            float gain = prevCompGain,
+                inSum = 0.f,
+                inPeak = 0.f;
+
+            for (int sample = 0; sample < numSamples; ++sample) {
+                const auto input = channelData[sample];
+                const auto level = (float)input;
+
+                inSum += level * level;
+                inPeak = jmax(inPeak, std::abs(level));
+
+                channelData[sample] = input * gain;
+                gain += compGainStep;
+            }
+
+            inBlock.sumOfSquares[channel] = inSum;
+            inBlock.peak[channel] = inPeak;
+            inputPeak = jmax(inputPeak, inPeak);
+        }
+    }
 
-    auto compGain_ = pow(10, compGain->get() / 20.0f);
-    buffer.applyGainRamp(0, buffer.getNumSamples(), prevCompGain, compGain_);
+    inputPeak *= jmax(prevCompGain, compGain_);
     prevCompGain = compGain_;
+    inLevels.push(inBlock);
 
-    for (int channel = 0; channel < supportedChannels; ++channel)
-        preCompAudio[channel].set(buffer.getRMSLevel(channel, 0, buffer.getNumSamples()));
+    kwire.setParams(getKwireParams(params));
+    kwire.setLinkMode((K_LinkMode)(int)params[KwireParam::linkMode]);
 
-    //make oversampled blocks
-    auto& osBlock = oversampler.processSamplesUp(block); 
-    auto& dryOsBlock = dryOversampler.processSamplesUp(dryBlock);
+    //External key, when it is on and the host provides it
+    auto* sidechainOversampler = engine.sidechainOversampler.get();
+    const bool sidechainOn = params[KwireParam::sidechain] >= 0.5f;
+    auto sidechainChannels = sidechainOn && sidechainOversampler != nullptr ? jmin(sidechainBuffer.getNumChannels(), (int)sidechainOversampler->numChannels) : 0;
 
-    //update params
-    //Ratio range (1 - 2)
-    kwire.updateParams(1.f + compRatio->get() * 0.01f, compThreshold->get(), compAttack->get(), compRelease->get());
+    //not fed while it was off, so its filters still hold the key from the last time it was used
+    if (sidechainOn && !sidechainWasOn && sidechainOversampler != nullptr)
+        sidechainOversampler->reset();
+
+    sidechainWasOn = sidechainOn;
+
+    const bool silent = inputPeak <= silenceLevel && (sidechainChannels == 0 || sidechainBuffer.getMagnitude(0, numSamples) <= silenceLevel);
+    silentSamples = silent ? jmin(silentSamples + numSamples, maxSilentSamples) : 0;
+
+    //Silence that has flushed through the wet path, with the envelopes at rest: processing would only output zeros,
+    //so the oversampling and kernels are skipped. The dry delay runs regardless, so nothing is out of line when sound returns.
+    if (silentSamples - numSamples >= getWetFlushSamples() && kwire.isAtRest()) {
+        block.clear();
+        kwire.idle(numSamples * (int)engine.oversampler->getOversamplingFactor());
+    }
+    else {
+        juce::dsp::AudioBlock<SampleType> osBlock, sidechainOsBlock;
+        const juce::dsp::AudioBlock<SampleType>* detectorBlock = nullptr;
 
-    //compress
-    kwire.compress(osBlock);
+        {
+            K_PROFILE_STAGE(&profiler, K_Stage::upsample);
 
-    //overdrive
-    kwire.overdrive(osBlock);
+            //make oversampled blocks
+            osBlock = engine.oversampler->processSamplesUp(block);
 
-    //downsampling
-    oversampler.processSamplesDown(block);
-    dryOversampler.processSamplesDown(dryBlock);
+            //External key, oversampled like the main signal
+            if (sidechainChannels > 0) {
+                sidechainOsBlock = sidechainOversampler->processSamplesUp(juce::dsp::AudioBlock<SampleType>(sidechainBuffer.getArrayOfWritePointers(), (size_t)sidechainChannels, (size_t)numSamples));
+                detectorBlock = &sidechainOsBlock;
+            }
+        }
 
-    for (int channel = 0; channel < supportedChannels; ++channel) {
-        compAudio[channel].set(buffer.getRMSLevel(channel, 0, buffer.getNumSamples()));
-        compAudioPeak[channel].set(buffer.getMagnitude(channel, 0, buffer.getNumSamples()));
+        //compress and overdrive, each timed inside
+        kwire.process(osBlock, detectorBlock);
+
+        {
+            K_PROFILE_STAGE(&profiler, K_Stage::downsample);
+
+            //downsampling
+            engine.oversampler->processSamplesDown(block);
+        }
     }
 
-    //Mix
-    for (int channel = 0; channel < totalNumInputChannels; ++channel) {
-        auto* channelData = block.getChannelPointer(channel);
-        auto* dryData = dryBlock.getChannelPointer(channel);
+    K_GainReductionBlock<maxSupportedChannels> reductionBlock;
+    reductionBlock.numSamples = numSamples;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        reductionBlock.minGain[channel] = kwire.getMinGain(channel);
+
+    gainReduction.push(reductionBlock);
+
+    //Mix and out gain in one pass, both smoothed over the block, metering the processed signal on the way
+    auto mix_ = jlimit(0.f, 100.f, params[KwireParam::mix]) * 0.01f;
+    auto outGain_ = juce::Decibels::decibelsToGain(params[KwireParam::outGain]);
 
-        auto scaledMix = jlimit(0.f, 100.f, mix->get()) * 0.01f;
-        
-       for (int sample = 0; sample < block.getNumSamples(); ++sample)
-            channelData[sample] = channelData[sample] * scaledMix + dryData[sample] * (1.f - scaledMix);
+    //Back from bypass, the emptied wet path takes the latency to fill. Stay on the dry signal, which the delay kept
+    //aligned, until it has, then fade the wet back in over at least as long again.
+    if (wetFadeSamples > 0) {
+        const auto hold = getLatencySamples();
+        const auto rampLength = jmax(hold, minWetFadeSamples);
+
+        wetFadeSamples = jmax(0, wetFadeSamples - numSamples);
+        mix_ *= jlimit(0.f, 1.f, (float)(rampLength - wetFadeSamples) / (float)rampLength);
     }
 
-    //Out gain
-    auto outGain_ = pow(10, outGain->get() / 20.0f);
-    buffer.applyGainRamp(0, buffer.getNumSamples(), prevOutGain, outGain_);
+    const K_Simd::OutputCoeffs outputCoeffs { prevMix, (mix_ - prevMix) / (float)numSamples,
+                                              prevOutGain, (outGain_ - prevOutGain) / (float)numSamples };
+
+    K_MeterBlock<maxSupportedChannels> compBlock;
+    compBlock.numSamples = numSamples;
+
+    {
+        K_PROFILE_STAGE(&profiler, K_Stage::output);
+
+        for (int channel = 0; channel < numChannels; ++channel) {
+            float sum, peak;
+            engine.outputKernels.mixAndGain(block.getChannelPointer(channel), dryBlock.getChannelPointer(channel), numSamples, outputCoeffs, sum, peak);
+
+            compBlock.sumOfSquares[channel] = sum;
+            compBlock.peak[channel] = peak;
+        }
+    }
+
+    compLevels.push(compBlock);
+
+    prevMix = mix_;
     prevOutGain = outGain_;
 }
 
@@ -237,18 +663,30 @@ juce::AudioProcessorEditor* KwireAudioProcessor::createEditor()
 //==============================================================================
 void KwireAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    auto state = treestate.copyState(); 
-    std::unique_ptr<juce::XmlElement> xml(state.createXml());
-    copyXmlToBinary(*xml, destData);
+    //see K_PresetFormat, a few dozen bytes
+    K_PresetFormat::write(destData, currentProgram.load(), getParamValues());
 }
 
 void KwireAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes)); 
+    auto values = getDefaultValues();
+    int program = 0;
+
+    if (!K_PresetFormat::read(data, sizeInBytes, program, values)) {
+        //sessions saved before the binary format hold the value tree as XML
+        std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
+
+        if (xmlState == nullptr || !xmlState->hasTagName(treestate.state.getType()))
+            return;
+
+        for (auto* param : xmlState->getChildWithTagNameIterator("PARAM"))
+            for (int index = 0; index < KwireParam::count; ++index)
+                if (param->getStringAttribute("id") == paramIDs[index])
+                    values[(size_t)index] = (float)param->getDoubleAttribute("value", values[(size_t)index]);
+    }
 
-    if (xmlState.get() != nullptr)
-        if (xmlState->hasTagName(treestate.state.getType()))
-            treestate.replaceState(juce::ValueTree::fromXml(*xmlState));
+    currentProgram = jlimit(0, numFactoryPresets - 1, program);
+    recall(values);
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout KwireAudioProcessor::makeParams() {
@@ -262,6 +700,11 @@ juce::AudioProcessorValueTreeState::ParameterLayout KwireAudioProcessor::makePar
     params.push_back(std::make_unique<juce::AudioParameterFloat>("compRelease", "Release", juce::NormalisableRange<float>(0.1f, 800.f, 0.1f, 0.4f), 10.f));
     params.push_back(std::make_unique<juce::AudioParameterFloat>("mix", "Mix", juce::NormalisableRange<float>(0.0f, 100.0f, 0.1f), 100.f));
     params.push_back(std::make_unique<juce::AudioParameterFloat>("outGain", "Output Gain", juce::NormalisableRange<float>(-24.f, 24.f, 0.1f), 0.0f));
+    params.push_back(std::make_unique<juce::AudioParameterChoice>("oversampling", "Oversampling", juce::StringArray{ "1x", "2x", "4x", "8x" }, 1));
+    params.push_back(std::make_unique<juce::AudioParameterChoice>("osFilter", "Oversampling Filter", juce::StringArray{ "FIR", "IIR" }, 0));
+    params.push_back(std::make_unique<juce::AudioParameterChoice>("linkMode", "Channel Link", juce::StringArray{ "Off", "Max", "Mean" }, 0));
+    params.push_back(std::make_unique<juce::AudioParameterBool>("sidechain", "External Sidechain", false));
+    params.push_back(std::make_unique<juce::AudioParameterFloat>("lookahead", "Lookahead", juce::NormalisableRange<float>(0.0f, maxLookaheadMs, 0.1f), 0.0f));
 
     return { params.begin(), params.end()};
 }
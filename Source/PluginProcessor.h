@@ -10,10 +10,32 @@
 
 #include <JuceHeader.h>
 #include "K_Kwire.h"
-constexpr auto supportedChannels = 2;
-constexpr auto osFactor = 1;
-
-class KwireAudioProcessor  : public juce::AudioProcessor
+#include "K_Delay.h"
+#include "K_Oversampler.h"
+#include "K_MeterFifo.h"
+#include "K_Preset.h"
+#include "K_RealtimeCheck.h"
+#include "K_Profiler.h"
+//Widest layout the engine is sized for: 7.1.4 needs 12, 16 leaves room for 9.1.6 and discrete setups
+constexpr auto maxSupportedChannels = 16;
+//Compressor lookahead range, in ms
+constexpr auto maxLookaheadMs = 10.f;
+//Last entry of the oversampling choice, 8x
+constexpr auto maxOversamplingIndex = 3;
+//Envelope times were voiced at 2x oversampling. The engine rate is scaled against this so they stay the same at every factor.
+constexpr auto voicingOsFactor = 2;
+
+//Parameters in the order of the binary state, which stores their values by position. Append only.
+namespace KwireParam {
+    enum Index { compGain, compRatio, compThreshold, compAttack, compRelease, mix, outGain,
+                 oversampling, osFilter, linkMode, sidechain, lookahead, count };
+}
+
+using KwireParamValues = K_ParamValues<KwireParam::count>;
+
+class KwireAudioProcessor  : public juce::AudioProcessor,
+                             private juce::AudioProcessorValueTreeState::Listener,
+                             private juce::Timer
 {
 public:
     //==============================================================================
@@ -23,12 +45,21 @@ public:
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    void reset() override;
 
    #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    //Keep the reported latency while bypassed
+    void processBlockBypassed (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlockBypassed (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    //The whole signal path runs natively in double when the host asks for it
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -53,36 +84,152 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    //Plain values of all the parameters, as the host sees them now
+    KwireParamValues getParamValues() const;
+
+    //Sets every parameter at once. The audio thread goes from the old values to the new ones between two blocks, never
+    //through a mix of both. Any thread but the audio thread.
+    void recall(const KwireParamValues& values);
+
     juce::AudioParameterFloat *compGain,
         *compRatio,
         *compThreshold,
         *compAttack,
         *compRelease,
         *mix,
-        *outGain;
+        *outGain,
+        *lookahead; //ms, adds as much latency
 
-    std::vector<juce::Atomic<float>> inAudio,
-        inAudioPeak,
-        compAudio,
-        compAudioPeak,
-        preCompAudio;
+    juce::AudioParameterChoice *oversampling, //1x, 2x, 4x, 8x
+        *osFilter, //FIR equiripple, polyphase IIR
+        *linkMode; //off, max, mean. See K_LinkMode
+
+    juce::AudioParameterBool *sidechain; //key the compressor from the sidechain bus, when the host has enabled it
+
+    //Per-block levels for the editor's meters: input and after the overdrive
+    K_MeterFifo<K_MeterBlock<maxSupportedChannels>> inLevels,
+        compLevels;
+
+    //Per-block lowest compressor gain, for the gain reduction meter
+    K_MeterFifo<K_GainReductionBlock<maxSupportedChannels>> gainReduction;
 
     //treestate
     juce::AudioProcessorValueTreeState treestate;
 
+   #if KWIRE_PROFILING
+    //Stage timing of this instance, for the editor's overlay and trace dumps
+    K_Profiler profiler;
+   #endif
+
+    //Whether the host's transport was running at the last block. Lets the editor idle when nothing plays.
+    bool isTransportPlaying() const { return transportPlaying.load(std::memory_order_relaxed); }
+
+    //The oversampler the engine runs. factorIndex and filterIndex follow the oversampling and osFilter parameters.
+    //The filter designs come from the shared cache, so this only allocates.
+    template <typename SampleType>
+    static std::unique_ptr<K_Oversampler<SampleType>> makeOversampler(int numChannels, int factorIndex, int filterIndex, int maxBlockSize);
+
 private:
+    //Everything on the signal path, in one precision. Only the one the host processes in is prepared.
+    template <typename SampleType>
+    struct Engine {
+        //Compressor, set to the bus width in prepareToPlay
+        K_Kwire<maxSupportedChannels, SampleType> kwire;
+
+        //Output stage kernel. It runs along the samples of each channel, so it takes the widest registers whatever the channel count.
+        const K_Simd::Kernels<SampleType>& outputKernels = K_Simd::getKernels<SampleType>(K_Simd::getBestInstructionSet(K_Simd::maxLanes));
+
+        juce::AudioBuffer<SampleType> dryBuffer;
+
+        std::unique_ptr<K_Oversampler<SampleType>> oversampler, //Oversampler, swapped when its settings change
+            sidechainOversampler; //Up only, for the detector. Null without a sidechain bus.
+
+        K_Delay<SampleType> dryDelay; //Keeps the dry signal aligned with the oversampler's latency
+
+        void reset();
+    };
+
     juce::AudioProcessorValueTreeState::ParameterLayout makeParams();
 
+    template <typename SampleType>
+    void process(juce::AudioBuffer<SampleType>& buffer, Engine<SampleType>& engine);
+
+    //At most preparedBlockSize samples of the main and sidechain buses
+    template <typename SampleType>
+    void processChunk(juce::AudioBuffer<SampleType>& mainBuffer, juce::AudioBuffer<SampleType>& sidechainBuffer,
+                      Engine<SampleType>& engine, const KwireParamValues& params);
+
+    template <typename SampleType>
+    void processBypassed(juce::AudioBuffer<SampleType>& buffer, Engine<SampleType>& engine);
+
+    template <typename SampleType>
+    void prepareEngine(Engine<SampleType>& engine, int samplesPerBlock);
+
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    void timerCallback() override;
+
+    //Rebuilds the oversampler and dry delay for the current oversampling and lookahead parameters. Message thread only.
+    void configureOversampling(bool force);
+
+    //Swaps the new settings into the engine between two blocks. Returns the latency.
+    template <typename SampleType>
+    int configureEngine(Engine<SampleType>& engine, int factorIndex, int filterIndex, int lookaheadSamples);
+
+    //The parameters for one block. Audio thread only.
+    KwireParamValues getBlockParams();
+
+    //Each parameter's default, for values a state doesn't have
+    KwireParamValues getDefaultValues() const;
+
+    //Compressor parameters as the engine takes them
+    static K_KwireParams getKwireParams(const KwireParamValues& values);
+
+    //Lookahead rounded to whole samples at the host rate
+    int getLookaheadSamples(float lookaheadMs) const;
+
+    //Channels of the sidechain bus, 0 when the host has it disabled
+    int getSidechainNumChannels() const;
+
+    //Host rate samples for the input's last sound to leave the oversampled path
+    int getWetFlushSamples() const;
+
+    double preparedSampleRate = 0.0;
+    int preparedBlockSize = 0,
+        activeOversampling = -1,
+        activeOsFilter = -1,
+        activeLookahead = -1; //host rate samples
+
+    //Set by parameterChanged, cleared by timerCallback once it has reconfigured
+    std::atomic<bool> reconfigurePending { false };
+    constexpr static int reconfigureCheckHz = 20;
+
+    std::atomic<bool> transportPlaying { false };
+
+    //Inputs at or below this (about -120 dB) count as silence
+    constexpr static float silenceLevel = 1.0e-6f;
+    constexpr static int maxSilentSamples = 1 << 30;
+
+    int silentSamples = 0; //host samples of silence in a row, up to maxSilentSamples
+    bool wetPathStale = false; //set while bypassed, the wet path holds audio from before
+    bool sidechainWasOn = false; //whether the last block keyed from the sidechain. Its filters hold audio from then.
+    int wetFadeSamples = 0; //after a bypass, host samples left until the wet path is fully mixed back in
+    constexpr static int minWetFadeSamples = 64;
+
+    //In KwireParam order, for recall
+    std::array<juce::RangedAudioParameter*, KwireParam::count> parameters {};
+
+    K_SnapshotExchange<KwireParamValues> recallSnapshots;
+    KwireParamValues recalledParams {}; //audio thread only
+    std::atomic<juce::uint32> recallGeneration { 0 }; //odd while recall writes the parameters one by one, bumped at both ends
+    juce::CriticalSection recallLock; //one recall at a time, so recallSnapshots has a single writer. Never taken by the audio thread.
+    std::atomic<int> currentProgram { 0 };
+
     float prevCompGain = 0.0f,
+        prevMix = 0.0f,
         prevOutGain = 0.0f;
-   
-    //Compressor
-    K_Kwire<supportedChannels> kwire;
-
-    juce::AudioBuffer<float> dryBuffer;
 
-    juce::dsp::Oversampling<float> oversampler, //Oversampler
-        dryOversampler; 
+    Engine<float> floatEngine;
+    Engine<double> doubleEngine;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (KwireAudioProcessor)
 };